@@ -0,0 +1,55 @@
+import std;
+import rio;
+
+struct Client
+{
+    rio::Tcp_socket sock;
+    std::array<char, 1024> buf{};
+};
+
+// Same shape as example 06, but every worker runs its own copy on its own core and ring.
+auto echo(rio::context &ctx, rio::Tcp_socket s)
+{
+    return rio::fut::loop(std::make_unique<Client>(Client{std::move(s)}), [&ctx](std::unique_ptr<Client> &ptr) {
+        Client *c = ptr.get();
+        return rio::fut::read(ctx, c->sock, c->buf).then([c, &ctx](std::size_t n) {
+            return rio::fut::write(ctx, c->sock, std::span(c->buf).first(n));
+        }).then([](std::size_t n) {
+            return rio::fut::make(n, [](std::size_t n) {
+                return n ? rio::fut::res<void>::ready() : rio::fut::res<void>::error(std::errc::connection_aborted);
+            });
+        });
+    });
+}
+
+auto main() -> int
+{
+    // Each worker gets its own SO_REUSEPORT listener on 6969, the kernel spreads connections across them.
+    rio::runtime rt({.workers = 4, .listen = rio::address::any_ipv4(6969)});
+
+    auto res = rt.start([](rio::worker &w) {
+        auto &ctx = *w.ctx;
+        w.spawn(rio::fut::loop(0, [&w, &ctx](int &) {
+            return rio::fut::accept(ctx, *w.listener).then([&w, &ctx](rio::fut::Accept_result r) {
+                std::println(" [RIO]: worker {} (cpu {}) got {}", w.id, w.cpu, r.address);
+                w.spawn(echo(ctx, std::move(r.client)));
+                return rio::fut::ready(0);
+            });
+        }));
+    });
+
+    if (!res)
+    {
+        std::println(" [RIO]: Fatal: {}", res.error());
+        return 1;
+    }
+
+    std::println(" [RIO]: Listening on 6969 with 4 workers...");
+
+    while (rt.running())
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+        for (const auto &s : rt.stats())
+            std::println(" [RIO]: worker {} cpu {}: live {} done {} completions {}", s.id, s.cpu, s.live, s.finished, s.completions);
+    }
+}
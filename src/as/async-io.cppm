@@ -1,6 +1,8 @@
 module;
 
 #include <liburing.h>
+#include <sys/socket.h>
+#include <cerrno>
 
 export module rio:asio;
 
@@ -8,17 +10,31 @@ export import :utils;
 export import :handle;
 export import :socket;
 export import :context;
+import :socket.unix_socket;
+import :socket.udp_socket;
 
 namespace rio::as {
 
 enum class Req_type { Read, Write, Accept };
 
-export struct accept_result
+export template <typename Sock>
+struct basic_accept_result
 {
-    rio::Tcp_socket client;
+    Sock client;
     rio::address address;
 };
 
+export using accept_result = basic_accept_result<rio::Tcp_socket>;
+export using unix_accept_result = basic_accept_result<rio::Unix_socket>;
+
+// Listening sockets accept() works on, the accepted connection comes back as the same type.
+template <typename Sock>
+concept Listener_C = std::same_as<Sock, rio::Tcp_socket> || std::same_as<Sock, rio::Unix_socket>;
+
+// Anything owning a socket fd: Tcp_socket, Unix_socket, ...
+template <typename Sock>
+concept Stream_C = requires(Sock &s) { s.fd.native_handle(); };
+
 template <typename Fn, typename User_data>
 struct uring_request
 {
@@ -45,7 +61,7 @@ struct uring_request
     }
 };
 
-template <typename Fn, typename User_data>
+template <typename Sock, typename Fn, typename User_data>
 struct uring_accept_request
 {
     internals::uring_request_header header;
@@ -68,11 +84,11 @@ struct uring_accept_request
         }
         else
         {
-            auto client_sock = rio::Tcp_socket::attach(res);
+            auto client_sock = Sock::attach(res);
             self->client_addr.len = self->addr_len;
 
             // Construct our dedicated result struct
-            accept_result result{.client = std::move(client_sock), .address = std::move(self->client_addr)};
+            basic_accept_result<Sock> result{.client = std::move(client_sock), .address = std::move(self->client_addr)};
 
             self->callback(self->context, std::move(result), self->user_data);
         }
@@ -87,12 +103,12 @@ concept On_Read_CB_C = std::invocable<Fn, rio::context &, rio::result<std::size_
 template <typename Fn, typename T>
 concept On_Write_CB_C = std::invocable<Fn, rio::context &, rio::result<std::size_t>, T *>;
 
-template <typename Fn, typename T>
-concept On_Accept_CB_C = std::invocable<Fn, rio::context &, rio::result<accept_result>, T *>;
+template <typename Fn, typename T, typename Sock = rio::Tcp_socket>
+concept On_Accept_CB_C = std::invocable<Fn, rio::context &, rio::result<basic_accept_result<Sock>>, T *>;
 
-export template <typename T, typename Fn>
+export template <typename T, typename Fn, Stream_C Sock>
 requires On_Read_CB_C<Fn, T>
-void read(rio::context &context, rio::Tcp_socket &sock, std::span<char> buffer, Fn &&on_read, T *user)
+void read(rio::context &context, Sock &sock, std::span<char> buffer, Fn &&on_read, T *user)
 {
     auto *sqe = context.sqe();
     if (!sqe) return;
@@ -115,9 +131,9 @@ void read(rio::context &context, rio::Tcp_socket &sock, std::span<char> buffer,
     context.submit();
 }
 
-export template <typename T, typename Fn>
+export template <typename T, typename Fn, Stream_C Sock>
 requires On_Write_CB_C<Fn, T>
-void write(rio::context &context, rio::Tcp_socket &sock, std::span<const char> buffer, Fn &&on_write, T *user)
+void write(rio::context &context, Sock &sock, std::span<const char> buffer, Fn &&on_write, T *user)
 {
     auto *sqe = context.sqe();
     if (!sqe) return;
@@ -140,14 +156,41 @@ void write(rio::context &context, rio::Tcp_socket &sock, std::span<const char> b
     context.submit();
 }
 
-export template <typename T, typename Fn>
-requires On_Accept_CB_C<Fn, T>
-void accept(rio::context &context, rio::Tcp_socket &listener, Fn &&on_accept, T *user)
+// Gathers `iov` into one write. The iovecs and what they point to must outlive the callback.
+export template <typename T, typename Fn, Stream_C Sock>
+requires On_Write_CB_C<Fn, T>
+void writev(rio::context &context, Sock &sock, std::span<const iovec> iov, Fn &&on_write, T *user)
 {
     auto *sqe = context.sqe();
     if (!sqe) return;
 
-    using request_type = uring_accept_request<std::decay_t<Fn>, T>;
+    using request_type = uring_request<std::decay_t<Fn>, T>;
+
+    auto *req = new request_type{
+        .header = {.call = &request_type::on_complete},
+        .type = Req_type::Write,
+        .handle = sock.fd.native_handle(),
+        .io_v = {},
+        .user_data = user,
+        .callback = std::forward<Fn>(on_write),
+        .context = context
+    };
+
+    io_uring_prep_writev(sqe, req->handle, iov.data(), static_cast<unsigned>(iov.size()), 0);
+
+    io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&req->header));
+    context.submit();
+}
+
+// The callback gets an accept_result for a Tcp_socket listener, a unix_accept_result for a Unix_socket one.
+export template <typename T, typename Fn, Listener_C Sock>
+requires On_Accept_CB_C<Fn, T, Sock>
+void accept(rio::context &context, Sock &listener, Fn &&on_accept, T *user)
+{
+    auto *sqe = context.sqe();
+    if (!sqe) return;
+
+    using request_type = uring_accept_request<Sock, std::decay_t<Fn>, T>;
 
     auto *req = new request_type{
         .header = {.call = &request_type::on_complete},
@@ -165,4 +208,235 @@ void accept(rio::context &context, rio::Tcp_socket &listener, Fn &&on_accept, T
     context.submit();
 }
 
+template <typename Fn, typename User_data>
+struct uring_fds_request
+{
+    internals::uring_request_header header;
+
+    rio::context &context;
+    User_data *user_data;
+    Fn callback;
+    bool receiving;
+
+    msghdr msg{};
+    iovec io_v{};
+    internals::fd_cmsg ctl{};
+
+    static void on_complete(internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<uring_fds_request *>(ptr);
+
+        if (res < 0)
+            self->callback(self->context, std::unexpected(rio::Err{-res, "Fd passing failed"}), self->user_data);
+        else if (self->receiving)
+            self->callback(self->context, internals::collect_fds(self->msg, static_cast<std::size_t>(res)), self->user_data);
+        else
+            self->callback(self->context, rio::fd_message{.bytes = static_cast<std::size_t>(res), .fds = {}}, self->user_data);
+
+        delete self;
+    }
+};
+
+template <typename Fn, typename T>
+concept On_Fds_CB_C = std::invocable<Fn, rio::context &, rio::result<rio::fd_message>, T *>;
+
+// sendmsg with SCM_RIGHTS on the ring. The callback gets bytes sent (fds stays empty).
+export template <typename T, typename Fn>
+requires On_Fds_CB_C<Fn, T>
+void send_fds(rio::context &context, rio::Unix_socket &sock, std::span<const char> buffer, std::span<const int> fds, Fn &&on_sent, T *user)
+{
+    using request_type = uring_fds_request<std::decay_t<Fn>, T>;
+
+    auto *req = new request_type{.context = context, .user_data = user, .callback = std::forward<Fn>(on_sent), .receiving = false};
+    req->header.call = &request_type::on_complete;
+
+    if (auto r = internals::prep_fd_send(req->msg, req->io_v, req->ctl, buffer, fds); !r)
+    {
+        req->callback(context, std::unexpected(r.error()), user);
+        delete req;
+        return;
+    }
+
+    auto *sqe = context.sqe();
+    if (!sqe)
+    {
+        delete req;
+        return;
+    }
+
+    io_uring_prep_sendmsg(sqe, sock.fd.native_handle(), &req->msg, MSG_NOSIGNAL);
+    io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&req->header));
+    context.submit();
+}
+
+// recvmsg with SCM_RIGHTS on the ring, received fds are close-on-exec and owned by the fd_message.
+export template <typename T, typename Fn>
+requires On_Fds_CB_C<Fn, T>
+void recv_fds(rio::context &context, rio::Unix_socket &sock, std::span<char> buffer, Fn &&on_recv, T *user)
+{
+    auto *sqe = context.sqe();
+    if (!sqe) return;
+
+    using request_type = uring_fds_request<std::decay_t<Fn>, T>;
+
+    auto *req = new request_type{.context = context, .user_data = user, .callback = std::forward<Fn>(on_recv), .receiving = true};
+    req->header.call = &request_type::on_complete;
+    internals::prep_fd_recv(req->msg, req->io_v, req->ctl, buffer);
+
+    io_uring_prep_recvmsg(sqe, sock.fd.native_handle(), &req->msg, MSG_CMSG_CLOEXEC);
+    io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&req->header));
+    context.submit();
+}
+
+template <typename Fn, typename User_data>
+struct uring_multishot_request
+{
+    internals::uring_request_header header;
+
+    rio::context &context;
+    User_data *user_data;
+    Fn callback;
+
+    int handle;
+    rio::buffer_ring &buffers;
+    msghdr tmpl{};
+    internals::udp_cmsg ctl{};
+
+    void arm()
+    {
+        auto *sqe = context.sqe();
+        io_uring_prep_recvmsg_multishot(sqe, handle, &tmpl, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = static_cast<std::uint16_t>(buffers.group);
+        io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&header));
+        context.submit();
+    }
+
+    static void on_complete(internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<uring_multishot_request *>(ptr);
+        const bool more = self->header.flags & IORING_CQE_F_MORE;
+
+        if (auto bid = rio::buffer_ring::buffer_id(self->header.flags))
+        {
+            // A record that doesn't fit its buffer is reported, the receive itself goes on.
+            if (auto m = internals::parse_multishot(self->buffers.buffer(*bid), res, self->tmpl))
+                self->callback(self->context, std::move(*m), self->user_data);
+            else
+                self->callback(self->context, std::unexpected(rio::Err::app(std::errc::bad_message, "Malformed multishot recvmsg")), self->user_data);
+            self->buffers.recycle(*bid);
+        }
+        else if (res < 0 && res != -ENOBUFS)
+        {
+            // Terminal: cancelled (fut::cancel_fd, closing the socket alone doesn't end it) or a socket error.
+            self->callback(self->context, std::unexpected(rio::Err{-res, "Multishot recvmsg failed"}), self->user_data);
+            if (!more)
+                delete self;
+            return;
+        }
+
+        // The kernel ends multishot on its own now and then (buffers ran out, overflowed CQ), keep it going.
+        if (!more)
+            self->arm();
+    }
+};
+
+template <typename Fn, typename T>
+concept On_Datagram_CB_C = std::invocable<Fn, rio::context &, rio::result<rio::udp_message>, T *>;
+
+// One multishot recvmsg with provided buffers: the callback runs once per received datagram (or GRO run) until
+// the op is cancelled (fut::cancel_fd) or fails, its last call carries the error. A datagram whose record can't be
+// parsed gets a bad_message call of its own and the receive continues. `buffers` must be registered
+// on `context` and outlive the receive; size them for the largest (GRO coalesced) message plus headers.
+export template <typename T, typename Fn>
+requires On_Datagram_CB_C<Fn, T>
+void recv_multishot(rio::context &context, rio::Udp_socket &sock, rio::buffer_ring &buffers, Fn &&on_datagram, T *user)
+{
+    using request_type = uring_multishot_request<std::decay_t<Fn>, T>;
+
+    auto *req = new request_type{.context = context, .user_data = user, .callback = std::forward<Fn>(on_datagram),
+                                 .handle = sock.fd.native_handle(), .buffers = buffers};
+    req->header.call = &request_type::on_complete;
+    req->tmpl.msg_namelen = sizeof(sockaddr_storage);
+    req->tmpl.msg_controllen = sizeof(req->ctl.buf);
+    req->arm();
+}
+
+template <typename Fn, typename User_data>
+struct uring_connect_request
+{
+    internals::uring_request_header header;
+
+    rio::context &context;
+    User_data *user_data;
+    Fn callback;
+
+    rio::Tcp_socket sock;
+    rio::address addr;
+    __kernel_timespec ts{};
+    bool timed = false;  // A link timeout was armed
+
+    static void on_complete(internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<uring_connect_request *>(ptr);
+
+        // -ECANCELED with a link timeout armed: it fired first. Otherwise someone cancelled us (fut::cancel_fd...).
+        if (res == -ECANCELED && self->timed)
+            self->callback(self->context, std::unexpected(rio::Err{std::errc::timed_out, std::format("Connect to '{}' timed out", self->addr)}), self->user_data);
+        else if (res < 0)
+            self->callback(self->context, std::unexpected(rio::Err{-res, std::format("Connect to '{}' failed", self->addr)}), self->user_data);
+        else
+            self->callback(self->context, std::move(self->sock), self->user_data);
+
+        delete self;
+    }
+};
+
+template <typename Fn, typename T>
+concept On_Connect_CB_C = std::invocable<Fn, rio::context &, rio::result<rio::Tcp_socket>, T *>;
+
+// Ring connect to `addr` with a fresh socket (family from the address). A non-zero `timeout` is linked to it.
+export template <typename T, typename Fn>
+requires On_Connect_CB_C<Fn, T>
+void connect(rio::context &context, const rio::address &addr, rio::s_opt options, std::chrono::nanoseconds timeout, Fn &&on_connect, T *user)
+{
+    auto sock = internals::client_socket(addr, options);
+    if (!sock)
+    {
+        on_connect(context, std::unexpected(sock.error()), user);
+        return;
+    }
+
+    // The connect and its timeout have to go out in one submit for the link to hold.
+    if (io_uring_sq_space_left(&context.ring) < 2)
+        context.submit();
+
+    auto *sqe = context.sqe();
+    if (!sqe)
+    {
+        on_connect(context, std::unexpected(rio::Err{std::errc::resource_unavailable_try_again, "No submission queue entry for connect"}), user);
+        return;
+    }
+
+    using request_type = uring_connect_request<std::decay_t<Fn>, T>;
+
+    auto *req = new request_type{.context = context, .user_data = user, .callback = std::forward<Fn>(on_connect), .sock = std::move(*sock), .addr = addr};
+    req->header.call = &request_type::on_complete;
+
+    io_uring_prep_connect(sqe, req->sock.fd.native_handle(), req->addr.data(), req->addr.size());
+    io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&req->header));
+
+    if (timeout > std::chrono::nanoseconds::zero())
+    {
+        io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+        req->ts = {.tv_sec = timeout.count() / 1'000'000'000, .tv_nsec = timeout.count() % 1'000'000'000};
+        req->timed = true;
+        auto *t = context.sqe();
+        io_uring_prep_link_timeout(t, &req->ts, 0);
+        io_uring_sqe_set_data(t, nullptr);
+    }
+
+    context.submit();
+}
+
 }  // namespace rio::as
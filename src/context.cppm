@@ -1,10 +1,19 @@
 module;
 
 #include <liburing.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <cerrno>
+#include "ring_futex.hpp"
 
 export module rio:context;
 
 import std;
+import :utils.result;
+import :utils.numa;
 
 namespace rio {
 
@@ -13,6 +22,187 @@ namespace rio {
     export struct uring_request_header
     {
         void (*call)(uring_request_header* self, int res);
+        std::uint32_t flags = 0;  // cqe->flags of the completion being delivered: IORING_CQE_F_MORE, provided buffer id
+    };
+
+    // Closure shipped to another ring with context::send_to. `failed` only ever fires on the sending ring,
+    // when the message could not be delivered, success on the sender is skipped (IOSQE_CQE_SKIP_SUCCESS).
+    template <typename Fn>
+    struct posted_call
+    {
+        struct back_ref
+        {
+            uring_request_header header;
+            posted_call *owner;
+        };
+
+        uring_request_header header;
+        back_ref failed;
+        Fn fn;
+
+        static void on_complete(uring_request_header *ptr, int)
+        {
+            auto *self = reinterpret_cast<posted_call *>(ptr);
+            self->fn();
+            delete self;
+        }
+
+        static void on_failed(uring_request_header *ptr, int)
+        {
+            delete reinterpret_cast<back_ref *>(ptr)->owner;
+        }
+    };
+
+    // Intrusive Vyukov MPSC queue: any thread pushes, only the owning thread pops.
+    struct inbox_node
+    {
+        std::atomic<inbox_node *> next{nullptr};
+        void (*run)(inbox_node *self) = nullptr;   // Runs the work, then frees the node
+        void (*drop)(inbox_node *self) = nullptr;  // Frees without running, for nodes left over at shutdown
+    };
+
+    template <typename Fn>
+    struct inbox_call : inbox_node
+    {
+        Fn fn;
+
+        explicit inbox_call(Fn f) : fn(std::move(f))
+        {
+            run = [](inbox_node *n) {
+                auto *self = static_cast<inbox_call *>(n);
+                self->fn();
+                delete self;
+            };
+            drop = [](inbox_node *n) { delete static_cast<inbox_call *>(n); };
+        }
+    };
+
+    struct inbox
+    {
+        uring_request_header header;          // Completion of the eventfd poll armed on the owner's ring.
+        alignas(64) std::atomic<inbox_node *> head;
+        alignas(64) inbox_node *tail;
+        inbox_node stub;
+        alignas(64) std::atomic<bool> notified{false};
+        int efd = -1;                          // Wakeup channel without ring futex support
+        std::atomic<std::uint32_t> futex_word{0};  // Wakeup channel with it: bumped and FUTEX_WAKEd
+        bool use_futex = false;
+        void *owner = nullptr;                 // context*, kept current across moves
+        void (*rearm)(void *owner) = nullptr;  // Cleared by context::quiesce, the wakeup is then not re-armed
+
+        explicit inbox(bool futex) : head(&stub), tail(&stub), use_futex(futex)
+        {
+            if (use_futex)
+                return;
+            efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (efd == -1)
+                throw std::runtime_error("Failed to create inbox eventfd.");
+        }
+
+        ~inbox()
+        {
+            while (auto *n = pop()) n->drop(n);
+            if (efd != -1)
+                ::close(efd);
+        }
+
+        void push(inbox_node *n)
+        {
+            n->next.store(nullptr, std::memory_order_relaxed);
+            inbox_node *prev = head.exchange(n, std::memory_order_acq_rel);
+            prev->next.store(n, std::memory_order_release);
+            wake();
+        }
+
+        // One eventfd write per drain cycle, everyone else rides along on the pending wakeup.
+        void wake()
+        {
+            if (notified.exchange(true, std::memory_order_acq_rel))
+                return;
+
+            if (use_futex)
+            {
+                // The owner's ring waits on this word, no fd to read back on the other side.
+                futex_word.fetch_add(1, std::memory_order_release);
+                ::syscall(SYS_futex, &futex_word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+                return;
+            }
+            std::uint64_t one = 1;
+            [[maybe_unused]] auto _ = ::write(efd, &one, sizeof(one));
+        }
+
+        auto pop() -> inbox_node *
+        {
+            inbox_node *t = tail;
+            inbox_node *next = t->next.load(std::memory_order_acquire);
+
+            if (t == &stub)
+            {
+                if (!next)
+                    return nullptr;
+                tail = next;
+                t = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+
+            if (next)
+            {
+                tail = next;
+                return t;
+            }
+
+            // A producer swapped head but has not linked yet, try again on the next drain.
+            if (t != head.load(std::memory_order_acquire))
+                return nullptr;
+
+            push_stub();
+            next = t->next.load(std::memory_order_acquire);
+            if (next)
+            {
+                tail = next;
+                return t;
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]] auto empty() const -> bool
+        {
+            return tail == &stub ? stub.next.load(std::memory_order_acquire) == nullptr : false;
+        }
+
+        // Clears the wakeup flag first, so a push racing with the drain writes the eventfd again.
+        auto drain() -> unsigned
+        {
+            notified.store(false, std::memory_order_release);
+            unsigned count = 0;
+            while (auto *n = pop())
+            {
+                n->run(n);
+                ++count;
+            }
+            return count;
+        }
+
+        static void on_wakeup(uring_request_header *ptr, int)
+        {
+            auto *self = reinterpret_cast<inbox *>(ptr);
+            if (!self->use_futex)
+            {
+                std::uint64_t v;
+                [[maybe_unused]] auto _ = ::read(self->efd, &v, sizeof(v));
+            }
+            if (self->rearm)
+                self->rearm(self->owner);
+            self->drain();
+        }
+
+    private:
+        void push_stub()
+        {
+            stub.next.store(nullptr, std::memory_order_relaxed);
+            inbox_node *prev = head.exchange(&stub, std::memory_order_acq_rel);
+            prev->next.store(&stub, std::memory_order_release);
+        }
     };
 
     };
@@ -29,10 +219,33 @@ export struct context
 
     std::vector<tombstone> graveyard;
 
-    explicit context(unsigned entries = 128)
+    // Cross-thread work queue, heap allocated so the ring's pointer to it survives moves.
+    std::unique_ptr<internals::inbox> mailbox;
+
+    // NUMA node the ring was set up for, -1 when created without one.
+    int node = -1;
+
+    explicit context(unsigned entries = 128) : context(entries, -1) {}
+
+    // Ring memory (SQ/CQ rings, SQE array) and the inbox are allocated while `numa_node` is the thread's preferred node.
+    // Pair it with a thread pinned to that node, whatever the thread touches next lands there by first touch.
+    // A node this machine doesn't have is treated as no node.
+    context(unsigned entries, int numa_node) : node(numa::valid_node(numa_node) ? numa_node : -1)
     {
+        numa::scoped_node placed(node);
+
         if (int ret = io_uring_queue_init(entries, &ring, 0); ret < 0)
             throw std::runtime_error(std::format("Failed to init io_uring, return: {}.", std::to_string(-ret)));
+
+#if RIO_HAS_RING_FUTEX
+        mailbox = std::make_unique<internals::inbox>(supports(IORING_OP_FUTEX_WAIT));
+#else
+        mailbox = std::make_unique<internals::inbox>(false);
+#endif
+        mailbox->header.call = &internals::inbox::on_wakeup;
+        mailbox->owner = this;
+        mailbox->rearm = [](void *self) { static_cast<context *>(self)->arm_inbox(); };
+        arm_inbox();
     }
 
     ~context()
@@ -44,10 +257,12 @@ export struct context
     context(const context &) = delete;
     context &operator=(const context &) = delete;
 
-    context(context &&other) noexcept
+    context(context &&other) noexcept : graveyard(std::move(other.graveyard)), mailbox(std::move(other.mailbox)), node(other.node)
     {
         ring = other.ring;
         other.ring.ring_fd = -1;
+        if (mailbox)
+            mailbox->owner = this;
     }
 
     context &operator=(context &&other) noexcept
@@ -59,6 +274,11 @@ export struct context
 
             ring = other.ring;
             other.ring.ring_fd = -1;
+            graveyard = std::move(other.graveyard);
+            mailbox = std::move(other.mailbox);
+            node = other.node;
+            if (mailbox)
+                mailbox->owner = this;
         }
         return *this;
     }
@@ -82,6 +302,98 @@ export struct context
         io_uring_submit(&ring);
     }
 
+    // --- Foreign threads ---
+    // Thread safe: runs fn() on the thread driving this context, during its next poll/try_poll.
+    // Lock-free push, and at most one eventfd write per drain no matter how many threads post.
+    template <std::invocable Fn>
+    void post(Fn &&fn)
+    {
+        mailbox->push(new internals::inbox_call<std::decay_t<Fn>>(std::forward<Fn>(fn)));
+    }
+
+    // Where the ring's shared memory lives relative to `node` (or the caller's current node when unset).
+    [[nodiscard]] auto ring_placement() const -> numa::placement
+    {
+        int home = node >= 0 ? node : numa::current_node();
+        auto region = [](const void *p, std::size_t len) { return std::span(static_cast<const std::byte *>(p), len); };
+
+        numa::placement p = numa::locate(region(ring.sq.ring_ptr, ring.sq.ring_sz), home);
+        if (ring.cq.ring_ptr != ring.sq.ring_ptr)
+            p += numa::locate(region(ring.cq.ring_ptr, ring.cq.ring_sz), home);
+        p += numa::locate(region(ring.sq.sqes, *ring.sq.kring_entries * sizeof(io_uring_sqe)), home);
+        return p;
+    }
+
+    // Kernel support for an io_uring opcode (IORING_OP_*).
+    [[nodiscard]] auto supports(int op) -> bool
+    {
+        io_uring_probe *probe = io_uring_get_probe_ring(&ring);
+        if (!probe)
+            return false;
+        bool ok = io_uring_opcode_supported(probe, op);
+        io_uring_free_probe(probe);
+        return ok;
+    }
+
+    // Ring futex ops usable here (liburing >= 2.5 and kernel >= 6.7). Cross-thread wakeups use them when true.
+    [[nodiscard]] auto has_ring_futex() const -> bool { return mailbox->use_futex; }
+
+    // Thread safe: makes the owning thread's next poll return without waiting, so its loop re-polls pending futures.
+    void wake() { mailbox->wake(); }
+
+    // --- Cross-ring messages (IORING_OP_MSG_RING) ---
+    // Posts a completion on `other`'s ring with user_data = msg and res = value. `other`'s try_poll dispatches it
+    // like any CQE, so msg->call runs on whichever thread drives `other`, no locks or eventfds involved.
+    // Plain fds are process wide, `value` can carry one as is. `on_failed` (optional) runs here only if delivery failed.
+    void send_to(context &other, internals::uring_request_header *msg, std::int32_t value = 0, internals::uring_request_header *on_failed = nullptr)
+    {
+        auto *s = sqe();
+        io_uring_prep_msg_ring(s, other.ring.ring_fd, static_cast<unsigned>(value), reinterpret_cast<std::uint64_t>(msg), 0);
+        io_uring_sqe_set_data(s, on_failed);
+        io_uring_sqe_set_flags(s, IOSQE_CQE_SKIP_SUCCESS);
+        submit();
+    }
+
+    // Runs fn() on `other`'s thread, during its next try_poll.
+    template <std::invocable Fn>
+    void send_to(context &other, Fn &&fn)
+    {
+        using msg_t = internals::posted_call<std::decay_t<Fn>>;
+        auto *m = new msg_t{.header = {.call = &msg_t::on_complete}, .failed = {.header = {.call = &msg_t::on_failed}, .owner = nullptr}, .fn = std::forward<Fn>(fn)};
+        m->failed.owner = m;
+        send_to(other, &m->header, 0, &m->failed.header);
+    }
+
+    // --- Fixed file table ---
+    auto register_fixed_files(unsigned count) -> result<void>
+    {
+        if (int ret = io_uring_register_files_sparse(&ring, count); ret < 0)
+            return std::unexpected(Err{-ret, "Failed to register sparse fixed file table"});
+        return {};
+    }
+
+    auto install_fixed(unsigned slot, int fd) -> result<void>
+    {
+        if (int ret = io_uring_register_files_update(&ring, slot, &fd, 1); ret < 0)
+            return std::unexpected(Err{-ret, std::format("Failed to install fd {} into fixed slot {}", fd, slot)});
+        return {};
+    }
+
+    // Moves our fixed file `src_slot` into `other`'s fixed table. dst_slot == IORING_FILE_INDEX_ALLOC picks a free one.
+    // `other` sees msg->call(msg, installed_slot). Both rings need a registered table.
+    void send_fixed_fd(context &other, unsigned src_slot, unsigned dst_slot, internals::uring_request_header *msg,
+        internals::uring_request_header *on_failed = nullptr)
+    {
+        auto *s = sqe();
+        if (dst_slot == IORING_FILE_INDEX_ALLOC)
+            io_uring_prep_msg_ring_fd_alloc(s, other.ring.ring_fd, static_cast<int>(src_slot), reinterpret_cast<std::uint64_t>(msg), 0);
+        else
+            io_uring_prep_msg_ring_fd(s, other.ring.ring_fd, static_cast<int>(src_slot), static_cast<int>(dst_slot), reinterpret_cast<std::uint64_t>(msg), 0);
+        io_uring_sqe_set_data(s, on_failed);
+        io_uring_sqe_set_flags(s, IOSQE_CQE_SKIP_SUCCESS);
+        submit();
+    }
+
     void poll()
     {
         io_uring_cqe *cqe;
@@ -93,10 +405,28 @@ export struct context
         try_poll();
     }
 
-    void try_poll()
+    // Waits at most `timeout` for a completion, then dispatches whatever landed. Returns completions handled.
+    template <typename Rep, typename Period>
+    auto poll_for(std::chrono::duration<Rep, Period> timeout) -> unsigned
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout);
+        __kernel_timespec ts{.tv_sec = ns.count() / 1'000'000'000, .tv_nsec = ns.count() % 1'000'000'000};
+
+        io_uring_cqe *cqe;
+        if (io_uring_wait_cqe_timeout(&ring, &cqe, &ts) < 0)
+            return 0;
+
+        return try_poll();
+    }
+
+    auto try_poll() -> unsigned
     {
         io_uring_cqe *cqe;
 
+        // Cheap when empty: one acquire load. Catches posts whose eventfd wakeup hasn't landed yet.
+        if (mailbox && !mailbox->empty())
+            mailbox->drain();
+
         // Process all available completions in the batch
         unsigned head;
         unsigned count = 0;
@@ -110,11 +440,13 @@ export struct context
             if (ptr)
             {
                 auto *req = static_cast<internals::uring_request_header *>(ptr);
+                req->flags = cqe->flags;
                 req->call(req, cqe->res);
             }
         }
 
         io_uring_cq_advance(&ring, count);
+        return count;
     }
 
     auto run(bool& quit)
@@ -128,6 +460,59 @@ export struct context
             this->poll();
     }
 
+    void arm_inbox()
+    {
+        auto *s = sqe();
+#if RIO_HAS_RING_FUTEX
+        // Armed with the value seen now: a wake that already bumped it completes at once with -EAGAIN.
+        if (mailbox->use_futex)
+            io_uring_prep_futex_wait(s, reinterpret_cast<std::uint32_t *>(&mailbox->futex_word), mailbox->futex_word.load(std::memory_order_acquire),
+                                     FUTEX_BITSET_MATCH_ANY, FUTEX2_SIZE_U32 | FUTEX2_PRIVATE, 0);
+        else
+#endif
+            io_uring_prep_poll_add(s, mailbox->efd, POLLIN);
+        io_uring_sqe_set_data(s, &mailbox->header);
+        submit();
+    }
+
+    // Cancels everything in flight (IORING_ASYNC_CANCEL_ANY) and dispatches the completions, pass after pass,
+    // until one finds nothing left or `timeout` passed. For shutdown: run it while the futures and callbacks
+    // those requests complete (and the buffers they write into) are still alive. The inbox stops re-arming.
+    // True once the ring is idle.
+    auto quiesce(std::chrono::milliseconds timeout = std::chrono::seconds{1}) -> bool
+    {
+        struct cancel_all
+        {
+            internals::uring_request_header header;
+            std::optional<int> res;
+
+            static void on_complete(internals::uring_request_header *ptr, int res) { reinterpret_cast<cancel_all *>(ptr)->res = res; }
+        };
+
+        mailbox->rearm = nullptr;
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true)
+        {
+            cancel_all c{.header = {.call = &cancel_all::on_complete}, .res = std::nullopt};
+            auto *s = sqe();
+            io_uring_prep_cancel(s, nullptr, IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL);
+            io_uring_sqe_set_data(s, &c.header);
+            submit();
+
+            // The cancel completes promptly, with how many requests it still found (ops running in io-wq count
+            // until they finish on their own).
+            while (!c.res) poll();
+            if (*c.res == 0 || *c.res == -ENOENT)
+            {
+                while (poll_for(std::chrono::milliseconds{0})) {}
+                return true;
+            }
+            if (*c.res < 0 || std::chrono::steady_clock::now() >= deadline)
+                return false;
+            poll_for(std::chrono::milliseconds{1});
+        }
+    }
+
     template <typename T>
     void defer_delete(T *ptr)
     {
@@ -159,5 +544,84 @@ export struct context
     }
 };
 
+// Provided buffers (IORING_REGISTER_PBUF_RING): the kernel picks a free buffer of group `group` when data
+// arrives, so multishot receives need no buffer per pending op. Completions carry the buffer id
+// (IORING_CQE_F_BUFFER), hand it back with recycle() once its bytes are consumed. Owned by one context.
+export struct buffer_ring
+{
+    rio::context *ctx = nullptr;
+    io_uring_buf_ring *br = nullptr;
+    std::unique_ptr<char[]> storage;
+    unsigned entries = 0;
+    unsigned buf_size = 0;
+    int group = 0;
+
+    // `entries` must be a power of two (at most 32768).
+    static auto create(rio::context &ctx, unsigned entries, unsigned buf_size, int group) -> result<buffer_ring>
+    {
+        if (!entries || (entries & (entries - 1)) || entries > 32768)
+            return std::unexpected(Err::app(std::errc::invalid_argument, "buffer_ring entries must be a power of two <= 32768"));
+
+        int err = 0;
+        auto *br = io_uring_setup_buf_ring(&ctx.ring, entries, group, 0, &err);
+        if (!br)
+            return std::unexpected(Err{-err, "Failed to register provided buffer ring"});
+
+        buffer_ring r;
+        r.ctx = &ctx;
+        r.br = br;
+        r.storage = std::make_unique_for_overwrite<char[]>(std::size_t{entries} * buf_size);
+        r.entries = entries;
+        r.buf_size = buf_size;
+        r.group = group;
+        for (unsigned i = 0; i < entries; ++i)
+            io_uring_buf_ring_add(br, r.buffer(i).data(), buf_size, static_cast<unsigned short>(i), io_uring_buf_ring_mask(entries), static_cast<int>(i));
+        io_uring_buf_ring_advance(br, static_cast<int>(entries));
+        return r;
+    }
+
+    buffer_ring() = default;
+    buffer_ring(buffer_ring &&o) noexcept
+        : ctx(std::exchange(o.ctx, nullptr)), br(std::exchange(o.br, nullptr)), storage(std::move(o.storage)), entries(o.entries), buf_size(o.buf_size), group(o.group) {}
+    buffer_ring &operator=(buffer_ring &&o) noexcept
+    {
+        if (this != &o)
+        {
+            release();
+            ctx = std::exchange(o.ctx, nullptr);
+            br = std::exchange(o.br, nullptr);
+            storage = std::move(o.storage);
+            entries = o.entries, buf_size = o.buf_size, group = o.group;
+        }
+        return *this;
+    }
+    ~buffer_ring() { release(); }
+
+    [[nodiscard]] auto buffer(unsigned bid) const -> std::span<char> { return {storage.get() + std::size_t{bid} * buf_size, buf_size}; }
+
+    // Buffer id of a completion, nullopt when it carried none (error, or no buffer was left: -ENOBUFS).
+    [[nodiscard]] static auto buffer_id(std::uint32_t cqe_flags) -> std::optional<unsigned>
+    {
+        if (!(cqe_flags & IORING_CQE_F_BUFFER))
+            return std::nullopt;
+        return cqe_flags >> IORING_CQE_BUFFER_SHIFT;
+    }
+
+    // Gives buffer `bid` back to the kernel.
+    void recycle(unsigned bid)
+    {
+        io_uring_buf_ring_add(br, buffer(bid).data(), buf_size, static_cast<unsigned short>(bid), io_uring_buf_ring_mask(entries), 0);
+        io_uring_buf_ring_advance(br, 1);
+    }
+
+private:
+    void release()
+    {
+        if (br && ctx && ctx->ring.ring_fd >= 0)
+            io_uring_free_buf_ring(&ctx->ring, br, entries, group);
+        br = nullptr;
+    }
+};
+
 } // namespace rio
 
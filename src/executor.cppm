@@ -0,0 +1,451 @@
+module;
+export module rio:executor;
+
+import std;
+import :context;
+import :utils;
+import :futures;
+import :fut.task;
+import :fut.io;
+import :runtime;
+
+namespace rio {
+
+// Opt-out marker for futures that must stay on the thread that created them.
+// Anything holding ring state (an Async_handle from fut::read/write/accept...) is tied to its context, and so is
+// every combinator built on one: then(), timeouts, stop_after, joins and races look through to what they hold.
+// Futures a lambda captures are out of sight, keep those on spawn_on().
+export template <typename F>
+struct not_send : std::false_type {};
+
+template <typename... Fs>
+using any_not_send = std::disjunction<not_send<Fs>...>;
+
+export template <typename T>
+struct not_send<fut::Async_handle<T>> : std::true_type {};
+
+export template <typename S, typename P>
+struct not_send<rio::Future<S, P>> : not_send<S> {};
+
+export template <typename F, typename Fn>
+struct not_send<fut::Then_impl<F, Fn>> : any_not_send<F, typename fut::Then_impl<F, Fn>::next_future_type> {};
+
+export template <typename F>
+struct not_send<fut::Timeout_impl<F>> : not_send<F> {};
+
+export template <typename F, typename C, typename R>
+struct not_send<fut::Timeout_with_impl<F, C, R>> : any_not_send<F, R> {};
+
+export template <typename S, typename B>
+struct not_send<fut::Loop_impl<S, B>> : any_not_send<S, typename fut::Loop_impl<S, B>::inner_future_type> {};
+
+export template <typename A, typename B>
+struct not_send<fut::Both_impl<A, B>> : any_not_send<A, B> {};
+
+export template <typename... Fs>
+struct not_send<fut::Join_impl<Fs...>> : any_not_send<Fs...> {};
+
+export template <typename... Fs>
+struct not_send<fut::First_of_impl<Fs...>> : any_not_send<Fs...> {};
+
+export template <typename C, typename P>
+struct not_send<fut::For_all<C, P>> : not_send<typename C::value_type> {};
+
+export template <typename F>
+concept Send_task = Pollable<std::decay_t<F>> && std::movable<std::decay_t<F>> && !not_send<std::decay_t<F>>::value;
+
+namespace internals {
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli: "Correct and Efficient Work-Stealing for
+// Weak Memory Models"). Owner pushes/pops at the bottom, thieves steal from the top.
+template <typename T>
+struct ws_deque
+{
+    struct ring
+    {
+        std::int64_t cap;
+        std::unique_ptr<std::atomic<T *>[]> slots;
+
+        explicit ring(std::int64_t c) : cap(c), slots(std::make_unique<std::atomic<T *>[]>(static_cast<std::size_t>(c))) {}
+        auto get(std::int64_t i) -> T * { return slots[static_cast<std::size_t>(i & (cap - 1))].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T *x) { slots[static_cast<std::size_t>(i & (cap - 1))].store(x, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<std::int64_t> top{0};
+    alignas(64) std::atomic<std::int64_t> bottom{0};
+    alignas(64) std::atomic<ring *> arr;
+    std::vector<std::unique_ptr<ring>> rings;  // Old rings stay alive, a thief may still be reading one.
+
+    explicit ws_deque(std::int64_t cap = 256)
+    {
+        rings.push_back(std::make_unique<ring>(cap));
+        arr.store(rings.back().get(), std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    void push(T *x)
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        ring *a = arr.load(std::memory_order_relaxed);
+
+        if (b - t > a->cap - 1)
+        {
+            rings.push_back(std::make_unique<ring>(a->cap * 2));
+            ring *bigger = rings.back().get();
+            for (std::int64_t i = t; i < b; ++i) bigger->put(i, a->get(i));
+            arr.store(bigger, std::memory_order_release);
+            a = bigger;
+        }
+
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    auto pop() -> T *
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        ring *a = arr.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T *x = a->get(b);
+        if (t == b)
+        {
+            // Last element, race thieves for it.
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                x = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // Any thread.
+    auto steal() -> T *
+    {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        ring *a = arr.load(std::memory_order_acquire);
+        T *x = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return x;
+    }
+
+    [[nodiscard]] auto size() const -> std::int64_t
+    {
+        return std::max<std::int64_t>(bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed), 0);
+    }
+};
+
+}  // namespace internals
+
+export struct executor_options
+{
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> cpus{};
+    unsigned ring_entries = 256;
+    std::chrono::milliseconds tick{1};  // Max sleep in the ring when a worker finds nothing runnable
+    bool numa_local = false;            // Workers allocate from their cpu's NUMA node (see runtime_options)
+};
+
+// Multi-threaded executor: every worker has a pinned thread, its own context and a Chase-Lev deque.
+// spawn() takes Send_task futures that may be stolen and polled by any worker.
+// spawn_on() builds a future on a given worker's thread (so it can use that worker's ring) and keeps it there,
+// it is polled alongside the ring completions that drive it.
+export struct executor
+{
+    using task_ptr = fut::task::base;
+
+    struct worker
+    {
+        std::size_t id;
+        int cpu;
+        int node = -1;
+        std::optional<rio::context> ctx{};
+        internals::ws_deque<task_ptr> deque{};
+        std::vector<task_ptr *> parked;  // Deque tasks that were pending, back on the deque at the next wakeup
+        std::vector<fut::task> pinned;
+        alignas(64) std::atomic<bool> sleeping{false};
+        std::atomic<std::uint64_t> polled{0}, stolen{0}, finished{0};
+        std::atomic<int> pin_error{0}, numa_error{0};  // errno from placing the thread, 0 when placed
+        std::uint64_t rng;
+
+        worker(std::size_t i, int c) : id(i), cpu(c), rng(0x9E3779B97F4A7C15ull * (i + 1)) {}
+    };
+
+    struct worker_snapshot
+    {
+        std::size_t id;
+        std::int64_t queued;
+        std::uint64_t polled, stolen, finished;
+        int pin_error, numa_error;
+    };
+
+    explicit executor(executor_options o = {});
+    ~executor();
+
+    executor(const executor &) = delete;
+    executor &operator=(const executor &) = delete;
+
+    // Thread safe. From a worker: pushed on its own deque. From elsewhere: handed to a worker round robin.
+    template <Send_task F>
+    void spawn(F &&f);
+
+    // Thread safe. make(context&) runs on worker `idx` and its result stays on that worker.
+    template <typename Make>
+    requires std::invocable<Make &, rio::context &> && Pollable<std::invoke_result_t<Make &, rio::context &>>
+    void spawn_on(std::size_t idx, Make &&make);
+
+    void stop();
+    [[nodiscard]] auto size() const -> std::size_t { return workers.size(); }
+    [[nodiscard]] auto context_of(std::size_t idx) -> rio::context & { return *workers[idx]->ctx; }
+    [[nodiscard]] auto stats() const -> std::vector<worker_snapshot>;
+
+    // Worker the calling thread belongs to, nullptr outside this executor.
+    static auto current() -> worker *;
+
+private:
+    void run(worker &w);
+    auto find_work(worker &w) -> task_ptr *;
+    void wake_one();
+    void push_local(worker &w, task_ptr *t);
+    void unpark(worker &w);
+
+    executor_options opts;
+    std::vector<std::unique_ptr<worker>> workers;
+    std::vector<std::jthread> threads;
+    std::atomic<bool> stopping{false};
+    std::atomic<std::size_t> next_rr{0};
+    std::atomic<std::size_t> sleepers{0};
+};
+
+thread_local executor::worker *tls_worker = nullptr;
+thread_local executor *tls_executor = nullptr;
+
+auto executor::current() -> worker * { return tls_worker; }
+
+executor::executor(executor_options o) : opts(std::move(o))
+{
+    const std::size_t n = std::max<std::size_t>(opts.workers, 1);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        workers.push_back(std::make_unique<worker>(i, i < opts.cpus.size() ? opts.cpus[i] : static_cast<int>(i)));
+        workers.back()->node = worker_node(opts.numa_local, workers.back()->cpu);
+    }
+
+    // Contexts are created on their own threads, spawn_on() needs them, so wait for all of them.
+    std::latch ready(static_cast<std::ptrdiff_t>(n));
+    threads.reserve(n);
+    for (auto &w : workers)
+        threads.emplace_back([this, &wk = *w, &ready] {
+            if (auto res = pin_to_cpu(wk.cpu); !res)
+                wk.pin_error.store(res.error().code.value(), std::memory_order_relaxed);
+            wk.numa_error.store(prefer_worker_node(wk.node), std::memory_order_relaxed);
+            wk.ctx.emplace(opts.ring_entries, wk.node);
+            ready.count_down();
+            run(wk);
+        });
+    ready.wait();
+}
+
+executor::~executor()
+{
+    stop();
+    threads.clear();
+
+    // Tasks never finished: queued, parked, or still in an inbox (those go with the context, their post owns them).
+    for (auto &w : workers)
+    {
+        while (auto *t = w->deque.pop()) delete t;
+        for (auto *t : w->parked) delete t;
+        w->parked.clear();
+    }
+}
+
+void executor::stop()
+{
+    stopping.store(true, std::memory_order_release);
+    for (auto &w : workers)
+        if (w->ctx)
+            w->ctx->post([] {});
+}
+
+void executor::wake_one()
+{
+    if (sleepers.load(std::memory_order_acquire) == 0)
+        return;
+    for (auto &w : workers)
+        if (w->sleeping.load(std::memory_order_acquire))
+        {
+            // Empty post, the inbox eventfd is what gets it out of the ring wait.
+            w->ctx->post([] {});
+            return;
+        }
+}
+
+void executor::push_local(worker &w, task_ptr *t)
+{
+    w.deque.push(t);
+    wake_one();
+}
+
+void executor::unpark(worker &w)
+{
+    // No wake_one(): this worker polls them on its next round anyway, waking sleepers would only bounce them.
+    for (auto *t : w.parked) w.deque.push(t);
+    w.parked.clear();
+}
+
+template <Send_task F>
+void executor::spawn(F &&f)
+{
+    fut::task t(std::forward<F>(f));
+
+    if (tls_executor == this && tls_worker)
+        return push_local(*tls_worker, t.ptr.release());
+
+    auto &w = *workers[next_rr.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+    w.ctx->post([this, &w, t = std::move(t)]() mutable { push_local(w, t.ptr.release()); });
+}
+
+template <typename Make>
+requires std::invocable<Make &, rio::context &> && Pollable<std::invoke_result_t<Make &, rio::context &>>
+void executor::spawn_on(std::size_t idx, Make &&make)
+{
+    auto &w = *workers[idx % workers.size()];
+    w.ctx->post([&w, m = std::forward<Make>(make)]() mutable { w.pinned.emplace_back(m(*w.ctx)); });
+}
+
+auto executor::find_work(worker &w) -> task_ptr *
+{
+    if (auto *t = w.deque.pop())
+        return t;
+
+    // Random victim first, then a full sweep, keeps thieves from piling on worker 0.
+    const std::size_t n = workers.size();
+    w.rng ^= w.rng << 13;
+    w.rng ^= w.rng >> 7;
+    w.rng ^= w.rng << 17;
+    std::size_t start = static_cast<std::size_t>(w.rng % n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto &victim = *workers[(start + i) % n];
+        if (&victim == &w)
+            continue;
+        if (auto *t = victim.deque.steal())
+        {
+            w.stolen.fetch_add(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+void executor::run(worker &w)
+{
+    tls_worker = &w;
+    tls_executor = this;
+    auto &ctx = *w.ctx;
+
+    // Pending deque tasks are parked, not re-polled: what readies them (a channel or promise on another thread,
+    // a finished op) wakes this ring, and any completion, inbox wakeup or tick puts them back on the deque.
+    // The tick counts even while busy, so deque or stolen work can't keep parked tasks from their deadline checks.
+    using clock = std::chrono::steady_clock;
+    auto last_unpark = clock::now();
+    auto release = [&] {
+        unpark(w);
+        last_unpark = clock::now();
+    };
+
+    while (!stopping.load(std::memory_order_acquire))
+    {
+        bool progress = ctx.try_poll() > 0;
+        if (progress || clock::now() - last_unpark >= opts.tick)
+            release();
+
+        for (std::size_t i = w.pinned.size(); i-- > 0;)
+        {
+            auto st = w.pinned[i].poll();
+            w.polled.fetch_add(1, std::memory_order_relaxed);
+            if (st == fut::status::pending)
+                continue;
+            progress = true;
+            w.finished.fetch_add(1, std::memory_order_relaxed);
+            if (i != w.pinned.size() - 1)
+                w.pinned[i] = std::move(w.pinned.back());
+            w.pinned.pop_back();
+        }
+
+        // Bounded batch so the ring and pinned tasks are never starved by a long deque.
+        for (int budget = 64; budget > 0; --budget)
+        {
+            task_ptr *t = find_work(w);
+            if (!t)
+                break;
+
+            w.polled.fetch_add(1, std::memory_order_relaxed);
+            if (t->poll() == fut::status::pending)
+            {
+                w.parked.push_back(t);
+                continue;
+            }
+            progress = true;
+            w.finished.fetch_add(1, std::memory_order_relaxed);
+            delete t;
+        }
+
+        // Nothing runnable, at most parked tasks: sleep until a completion or a post, the tick bounds the wait for
+        // tasks nothing wakes (deadlines checked on poll). Either way the parked ones get their next poll.
+        if (!progress && w.deque.size() == 0)
+        {
+            w.sleeping.store(true, std::memory_order_release);
+            sleepers.fetch_add(1, std::memory_order_acq_rel);
+            ctx.poll_for(opts.tick);
+            sleepers.fetch_sub(1, std::memory_order_acq_rel);
+            w.sleeping.store(false, std::memory_order_release);
+            release();
+        }
+
+        ctx.purge_graveyard();
+    }
+
+    // Pinned tasks may point into this ring: cancel and complete what they have in flight, then drop them.
+    ctx.quiesce();
+    w.pinned.clear();
+    tls_worker = nullptr;
+    tls_executor = nullptr;
+}
+
+auto executor::stats() const -> std::vector<worker_snapshot>
+{
+    std::vector<worker_snapshot> out;
+    for (const auto &w : workers)
+        out.push_back({
+            .id = w->id,
+            .queued = w->deque.size(),
+            .polled = w->polled.load(std::memory_order_relaxed),
+            .stolen = w->stolen.load(std::memory_order_relaxed),
+            .finished = w->finished.load(std::memory_order_relaxed),
+            .pin_error = w->pin_error.load(std::memory_order_relaxed),
+            .numa_error = w->numa_error.load(std::memory_order_relaxed),
+        });
+    return out;
+}
+
+}  // namespace rio
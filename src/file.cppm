@@ -2,6 +2,8 @@ module;
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <cerrno>
 
 export module rio:file;
@@ -75,4 +77,61 @@ auto file::detatch() -> int
     return fd.detatch();
 }
 
+// Read-only shared mapping of a whole file. The file can be closed once mapped.
+export struct mapped_file
+{
+    const char *data = nullptr;
+    std::size_t size = 0;
+
+    mapped_file() = default;
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    mapped_file(mapped_file &&other) noexcept : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+    mapped_file &operator=(mapped_file &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+        }
+        return *this;
+    }
+    ~mapped_file() { unmap(); }
+
+    static auto map(const file &f) -> result<mapped_file>;
+
+    auto view() const -> std::string_view { return {data, size}; }
+    explicit operator bool() const { return data != nullptr; }
+
+private:
+    void unmap()
+    {
+        if (data && size)
+            ::munmap(const_cast<char *>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+};
+
+auto mapped_file::map(const file &f) -> result<mapped_file>
+{
+    struct stat st{};
+    if (::fstat(f.fd, &st) == -1)
+        return std::unexpected(rio::Err::sys("Failed to stat file for mapping."));
+
+    mapped_file m;
+    if (st.st_size == 0)
+        return m;  // mmap refuses zero length, an empty view is what the caller wants anyway
+
+    void *p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, f.fd, 0);
+    if (p == MAP_FAILED)
+        return std::unexpected(rio::Err::sys("Failed to map file."));
+
+    m.data = static_cast<const char *>(p);
+    m.size = static_cast<std::size_t>(st.st_size);
+    return m;
+}
+
 }  // namespace rio
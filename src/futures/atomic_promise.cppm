@@ -0,0 +1,178 @@
+module;
+export module rio:fut.atomic_promise;
+
+import std;
+import :context;
+import :futures;
+
+namespace rio::promise {
+
+// Promise state that may be resolved from any thread, unlike promise::State.
+// One allocation carries the value, the refcount and the inbox node used to wake the home context,
+// so resolve never allocates, locks or loops: a CAS to claim, a release store, one inbox push.
+export template <typename T>
+struct Atomic_state : rio::internals::inbox_node
+{
+    using value_type = T;
+    using storage_t = std::conditional_t<std::is_void_v<T>, std::monostate, std::optional<T>>;
+
+    enum phase_t : std::uint8_t { empty, writing, ready };
+
+    std::atomic<std::uint32_t> refs{2};  // Promise + future, +1 while queued on the home inbox
+    std::atomic<std::uint8_t> phase{empty};
+    storage_t value{};
+    std::error_code error{};
+    rio::internals::inbox *home = nullptr;  // The inbox object survives context moves, the context address doesn't
+
+    explicit Atomic_state(rio::internals::inbox *h) : home(h)
+    {
+        run = [](inbox_node *n) { static_cast<Atomic_state *>(n)->release(); };
+        drop = run;
+    }
+
+    // First resolve/reject wins, later ones return false and change nothing.
+    template <typename... Args>
+    auto resolve(Args &&...args) -> bool
+    {
+        if (!claim())
+            return false;
+        if constexpr (!std::is_void_v<T>)
+            value.emplace(std::forward<Args>(args)...);
+        publish();
+        return true;
+    }
+
+    auto reject(std::error_code ec) -> bool
+    {
+        if (!claim())
+            return false;
+        error = ec;
+        publish();
+        return true;
+    }
+
+    // Owning (future) side only.
+    auto poll() -> rio::fut::res<T>
+    {
+        if (phase.load(std::memory_order_acquire) != ready)
+            return rio::fut::res<T>::pending();
+        if (error)
+            return rio::fut::res<T>::error(error);
+        if constexpr (std::is_void_v<T>)
+            return rio::fut::res<void>::ready();
+        else
+            return rio::fut::res<T>::ready(std::move(*value));
+    }
+
+    void release()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+private:
+    auto claim() -> bool
+    {
+        std::uint8_t expected = empty;
+        return phase.compare_exchange_strong(expected, writing, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void publish()
+    {
+        // The queued node holds its own ref, the home thread drops it after the drain.
+        if (home)
+            refs.fetch_add(1, std::memory_order_relaxed);
+        phase.store(ready, std::memory_order_release);
+        // Wakes the home ring out of its wait, its loop then re-polls the task holding the future.
+        if (home)
+            home->push(this);
+    }
+};
+
+// Resolving end, movable to any thread. Dropping it unresolved rejects with broken_promise.
+export template <typename T>
+struct Atomic_promise
+{
+    Atomic_state<T> *state = nullptr;
+
+    explicit Atomic_promise(Atomic_state<T> *s) : state(s) {}
+    Atomic_promise(Atomic_promise &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+    Atomic_promise &operator=(Atomic_promise &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+    Atomic_promise(const Atomic_promise &) = delete;
+    Atomic_promise &operator=(const Atomic_promise &) = delete;
+    ~Atomic_promise() { reset(); }
+
+    template <typename... Args>
+    auto resolve(Args &&...args) -> bool { return state->resolve(std::forward<Args>(args)...); }
+    auto reject(std::error_code ec) -> bool { return state->reject(ec); }
+
+private:
+    void reset()
+    {
+        if (!state)
+            return;
+        state->reject(std::make_error_code(std::future_errc::broken_promise));
+        state->release();
+        state = nullptr;
+    }
+};
+
+template <typename T>
+struct Atomic_handle
+{
+    Atomic_state<T> *ptr = nullptr;
+
+    explicit Atomic_handle(Atomic_state<T> *s) : ptr(s) {}
+    Atomic_handle(Atomic_handle &&other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+    Atomic_handle &operator=(Atomic_handle &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (ptr)
+                ptr->release();
+            ptr = std::exchange(other.ptr, nullptr);
+        }
+        return *this;
+    }
+    Atomic_handle(const Atomic_handle &) = delete;
+    Atomic_handle &operator=(const Atomic_handle &) = delete;
+    ~Atomic_handle()
+    {
+        if (ptr)
+            ptr->release();
+    }
+};
+
+struct Atomic_poller
+{
+    template <typename T>
+    auto operator()(Atomic_handle<T> &h) const { return h.ptr->poll(); }
+};
+
+// Promise/future pair for handing results across threads. The future belongs to `home`: resolving wakes
+// that context so its loop re-polls the waiting task. The promise may be resolved from anywhere.
+// `home` must outlive the pair.
+export template <typename T>
+auto make_atomic(rio::context &home)
+{
+    auto *s = new Atomic_state<T>(home.mailbox.get());
+    return std::pair{Atomic_promise<T>{s}, rio::Future(Atomic_handle<T>{s}, Atomic_poller{})};
+}
+
+// Same, with no context to wake: the result is seen on the next poll of the future, whenever that is.
+export template <typename T>
+auto make_atomic()
+{
+    auto *s = new Atomic_state<T>(nullptr);
+    return std::pair{Atomic_promise<T>{s}, rio::Future(Atomic_handle<T>{s}, Atomic_poller{})};
+}
+
+}  // namespace rio::promise
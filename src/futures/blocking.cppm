@@ -0,0 +1,222 @@
+module;
+export module rio:fut.blocking;
+
+import std;
+import :context;
+import :futures;
+import :fut.atomic_promise;
+
+namespace rio::fut {
+
+export struct blocking_pool_options
+{
+    std::size_t threads = 4;
+    std::size_t max_queue = 1024;  // Jobs beyond this are rejected with resource_unavailable_try_again.
+};
+
+// Thread pool for work that must not run on a ring thread: compression, hashing, getaddrinfo, legacy syscalls.
+// Jobs run off-loop and resolve an atomic promise in place, which wakes the context that owns the future.
+export struct blocking_pool
+{
+    struct stats_t
+    {
+        std::uint64_t queued;      // Waiting right now
+        std::uint64_t running;     // Executing right now
+        std::uint64_t completed;
+        std::uint64_t rejected;
+        std::chrono::nanoseconds avg_wait, max_wait;  // Enqueue -> start
+        std::chrono::nanoseconds avg_run, max_run;    // Start -> end
+    };
+
+    explicit blocking_pool(blocking_pool_options o = {});
+    ~blocking_pool();
+
+    blocking_pool(const blocking_pool &) = delete;
+    blocking_pool &operator=(const blocking_pool &) = delete;
+
+    // fn() runs on a pool thread, the returned future resolves on `ctx` with its result.
+    template <typename Fn>
+    requires std::invocable<Fn &>
+    auto spawn(rio::context &ctx, Fn &&fn);
+
+    [[nodiscard]] auto stats() const -> stats_t;
+
+private:
+    struct job
+    {
+        virtual ~job() = default;
+        virtual void run() = 0;
+        virtual void cancel() = 0;  // Pool shutting down or queue full
+        std::chrono::steady_clock::time_point enqueued{};
+    };
+
+    template <typename T, typename Fn>
+    struct job_impl final : job
+    {
+        rio::promise::Atomic_promise<T> promise;
+        Fn fn;
+
+        job_impl(rio::promise::Atomic_promise<T> p, Fn f) : promise(std::move(p)), fn(std::move(f)) {}
+
+        void run() override
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    fn();
+                    promise.resolve();
+                }
+                else
+                    promise.resolve(fn());
+            }
+            catch (...)
+            {
+                // res only carries error codes, the exception itself can't cross over.
+                promise.reject(std::make_error_code(std::errc::state_not_recoverable));
+            }
+        }
+
+        void cancel() override { promise.reject(std::make_error_code(std::errc::resource_unavailable_try_again)); }
+    };
+
+    auto enqueue(std::unique_ptr<job> j) -> bool;
+    void worker_loop();
+
+    blocking_pool_options opts;
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::unique_ptr<job>> queue;
+    bool stopping = false;
+    std::vector<std::jthread> threads;
+
+    std::atomic<std::uint64_t> running{0}, completed{0}, rejected{0};
+    std::atomic<std::uint64_t> wait_ns{0}, run_ns{0}, max_wait_ns{0}, max_run_ns{0};
+};
+
+blocking_pool::blocking_pool(blocking_pool_options o) : opts(o)
+{
+    threads.reserve(std::max<std::size_t>(opts.threads, 1));
+    for (std::size_t i = 0; i < std::max<std::size_t>(opts.threads, 1); ++i) threads.emplace_back([this] { worker_loop(); });
+}
+
+blocking_pool::~blocking_pool()
+{
+    {
+        std::lock_guard lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    threads.clear();
+
+    for (auto &j : queue) j->cancel();
+}
+
+auto blocking_pool::enqueue(std::unique_ptr<job> j) -> bool
+{
+    {
+        std::lock_guard lock(mtx);
+        if (stopping || queue.size() >= opts.max_queue)
+        {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            j->cancel();
+            return false;
+        }
+        j->enqueued = std::chrono::steady_clock::now();
+        queue.push_back(std::move(j));
+    }
+    cv.notify_one();
+    return true;
+}
+
+void blocking_pool::worker_loop()
+{
+    auto bump_max = [](std::atomic<std::uint64_t> &m, std::uint64_t v) {
+        auto cur = m.load(std::memory_order_relaxed);
+        while (v > cur && !m.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+    };
+
+    while (true)
+    {
+        std::unique_ptr<job> j;
+        {
+            std::unique_lock lock(mtx);
+            cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            j = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto waited = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(start - j->enqueued).count());
+
+        running.fetch_add(1, std::memory_order_relaxed);
+        j->run();
+        running.fetch_sub(1, std::memory_order_relaxed);
+
+        auto ran = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        wait_ns.fetch_add(waited, std::memory_order_relaxed);
+        run_ns.fetch_add(ran, std::memory_order_relaxed);
+        bump_max(max_wait_ns, waited);
+        bump_max(max_run_ns, ran);
+        completed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename Fn>
+requires std::invocable<Fn &>
+auto blocking_pool::spawn(rio::context &ctx, Fn &&fn)
+{
+    using T = std::invoke_result_t<Fn &>;
+    auto [p, f] = rio::promise::make_atomic<T>(ctx);
+    enqueue(std::make_unique<job_impl<T, std::decay_t<Fn>>>(std::move(p), std::forward<Fn>(fn)));
+    return std::move(f);
+}
+
+auto blocking_pool::stats() const -> stats_t
+{
+    constexpr auto r = std::memory_order_relaxed;
+    std::uint64_t done = completed.load(r);
+    std::uint64_t depth;
+    {
+        std::lock_guard lock(mtx);
+        depth = queue.size();
+    }
+
+    using ns = std::chrono::nanoseconds;
+    return {
+        .queued = depth,
+        .running = running.load(r),
+        .completed = done,
+        .rejected = rejected.load(r),
+        .avg_wait = ns(done ? wait_ns.load(r) / done : 0),
+        .max_wait = ns(max_wait_ns.load(r)),
+        .avg_run = ns(done ? run_ns.load(r) / done : 0),
+        .max_run = ns(max_run_ns.load(r)),
+    };
+}
+
+// Process wide pool used by spawn_blocking(ctx, fn), sized to the machine.
+export auto default_blocking_pool() -> blocking_pool &
+{
+    static blocking_pool pool({.threads = std::max(4u, std::thread::hardware_concurrency()), .max_queue = 4096});
+    return pool;
+}
+
+export template <typename Fn>
+requires std::invocable<Fn &>
+auto spawn_blocking(blocking_pool &pool, rio::context &ctx, Fn &&fn)
+{
+    return pool.spawn(ctx, std::forward<Fn>(fn));
+}
+
+export template <typename Fn>
+requires std::invocable<Fn &>
+auto spawn_blocking(rio::context &ctx, Fn &&fn)
+{
+    return default_blocking_pool().spawn(ctx, std::forward<Fn>(fn));
+}
+
+}  // namespace rio::fut
@@ -0,0 +1,551 @@
+module;
+export module rio:fut.channel;
+
+import std;
+import :context;
+import :futures;
+
+namespace rio::fut {
+
+export enum class chan_status : std::uint8_t { ok, full, closed };
+
+namespace detail {
+
+// Vyukov bounded queue with a single consumer. Any capacity, every cell carries a sequence number.
+template <typename T>
+struct bounded_ring
+{
+    struct cell
+    {
+        std::atomic<std::size_t> seq{0};
+        std::optional<T> v{};
+    };
+
+    std::size_t cap;
+    std::unique_ptr<cell[]> cells;
+    alignas(64) std::atomic<std::size_t> enq{0};
+    alignas(64) std::atomic<std::size_t> deq{0};  // Written by the consumer only
+
+    explicit bounded_ring(std::size_t c) : cap(std::max<std::size_t>(c, 1)), cells(std::make_unique<cell[]>(cap))
+    {
+        for (std::size_t i = 0; i < cap; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // Moves from v only on success.
+    auto try_push(T &v) -> bool
+    {
+        std::size_t pos = enq.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell &c = cells[pos % cap];
+            std::size_t seq = c.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+            if (diff == 0)
+            {
+                if (enq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.v.emplace(std::move(v));
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;  // Consumer hasn't freed this cell yet
+            else
+                pos = enq.load(std::memory_order_relaxed);
+        }
+    }
+
+    auto try_pop() -> std::optional<T>
+    {
+        std::size_t pos = deq.load(std::memory_order_relaxed);
+        cell &c = cells[pos % cap];
+        if (c.seq.load(std::memory_order_acquire) != pos + 1)
+            return std::nullopt;
+
+        std::optional<T> out(std::move(*c.v));
+        c.v.reset();
+        c.seq.store(pos + cap, std::memory_order_release);
+        deq.store(pos + 1, std::memory_order_relaxed);
+        return out;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        auto e = enq.load(std::memory_order_relaxed), d = deq.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+};
+
+// Vyukov intrusive MPSC list, one node per message. Never full.
+template <typename T>
+struct unbounded_list
+{
+    struct node
+    {
+        std::atomic<node *> next{nullptr};
+        std::optional<T> v{};
+    };
+
+    alignas(64) std::atomic<node *> head;
+    alignas(64) node *tail;  // Consumer only, always the already-consumed (stub) node
+    std::atomic<std::size_t> count{0};
+
+    explicit unbounded_list(std::size_t = 0) : head(new node), tail(head.load(std::memory_order_relaxed)) {}
+
+    ~unbounded_list()
+    {
+        while (tail)
+        {
+            node *n = tail->next.load(std::memory_order_relaxed);
+            delete tail;
+            tail = n;
+        }
+    }
+
+    auto try_push(T &v) -> bool
+    {
+        auto *n = new node;
+        n->v.emplace(std::move(v));
+        node *prev = head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+        count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // A producer between its exchange and its link looks like an empty queue, it wakes us right after linking.
+    auto try_pop() -> std::optional<T>
+    {
+        node *next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return std::nullopt;
+
+        std::optional<T> out(std::move(*next->v));
+        next->v.reset();
+        delete tail;
+        tail = next;
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return out;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return count.load(std::memory_order_relaxed); }
+};
+
+// Shared by any number of senders on any threads and one receiver. The data path is lock-free;
+// parking only sets a flag, and the other side wakes the parked context when it sees that flag.
+// Senders blocked on a full channel are rare enough to sit in a mutex-guarded list.
+template <typename T, typename Queue>
+struct atomic_state
+{
+    using value_type = T;
+
+    Queue q;
+    std::atomic<std::uint32_t> refs{2};
+    std::atomic<std::size_t> senders{1};
+    std::atomic<bool> rx_alive{true};
+    std::atomic<rio::internals::inbox *> rx_home;
+    std::atomic<bool> rx_parked{false};
+    std::atomic<bool> tx_parked{false};
+    std::mutex tx_mtx;
+    std::vector<rio::internals::inbox *> tx_homes;
+
+    atomic_state(rio::internals::inbox *home, std::size_t capacity) : q(capacity), rx_home(home) {}
+
+    auto try_push(T &v) -> chan_status
+    {
+        if (!rx_alive.load(std::memory_order_acquire))
+            return chan_status::closed;
+        if (!q.try_push(v))
+            return chan_status::full;
+        wake_rx();
+        return chan_status::ok;
+    }
+
+    auto try_pop() -> std::optional<T>
+    {
+        auto v = q.try_pop();
+        if (v)
+            wake_tx();
+        return v;
+    }
+
+    // Park, then the caller re-checks: a push landing in between sees the flag and wakes us.
+    void park_rx()
+    {
+        rx_parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void park_tx(rio::internals::inbox *home)
+    {
+        {
+            std::lock_guard lock(tx_mtx);
+            if (home && std::ranges::find(tx_homes, home) == tx_homes.end())
+                tx_homes.push_back(home);
+            tx_parked.store(true, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    [[nodiscard]] auto rx_closed() const -> bool { return senders.load(std::memory_order_acquire) == 0; }
+    [[nodiscard]] auto tx_closed() const -> bool { return !rx_alive.load(std::memory_order_acquire); }
+    [[nodiscard]] auto size() const -> std::size_t { return q.size(); }
+
+    void rebind_rx(rio::internals::inbox *home) { rx_home.store(home, std::memory_order_release); }
+
+    void add_sender()
+    {
+        senders.fetch_add(1, std::memory_order_relaxed);
+        refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void drop_sender()
+    {
+        if (senders.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            wake_rx();
+        release();
+    }
+
+    void drop_receiver()
+    {
+        rx_alive.store(false, std::memory_order_release);
+        wake_tx();
+        release();
+    }
+
+private:
+    void wake_rx()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (rx_parked.load(std::memory_order_relaxed) && rx_parked.exchange(false, std::memory_order_acq_rel))
+            if (auto *h = rx_home.load(std::memory_order_acquire))
+                h->wake();
+    }
+
+    void wake_tx()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!tx_parked.load(std::memory_order_relaxed) || !tx_parked.exchange(false, std::memory_order_acq_rel))
+            return;
+
+        std::vector<rio::internals::inbox *> homes;
+        {
+            std::lock_guard lock(tx_mtx);
+            homes.swap(tx_homes);
+        }
+        for (auto *h : homes) h->wake();
+    }
+
+    void release()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+};
+
+// Both ends on one thread: no atomics, a deque, capacity 0 means unbounded.
+// Wakes still go through the inbox so a loop sleeping in the ring comes back for the parked side.
+template <typename T>
+struct local_state
+{
+    using value_type = T;
+
+    std::deque<T> q;
+    std::size_t cap;
+    rio::internals::inbox *home;
+    std::uint32_t refs = 2;
+    std::size_t senders = 1;
+    bool rx_alive = true;
+    bool rx_parked = false;
+    bool tx_parked = false;
+
+    local_state(rio::internals::inbox *h, std::size_t capacity) : cap(capacity), home(h) {}
+
+    auto try_push(T &v) -> chan_status
+    {
+        if (!rx_alive)
+            return chan_status::closed;
+        if (cap && q.size() >= cap)
+            return chan_status::full;
+        q.push_back(std::move(v));
+        wake(rx_parked);
+        return chan_status::ok;
+    }
+
+    auto try_pop() -> std::optional<T>
+    {
+        if (q.empty())
+            return std::nullopt;
+        std::optional<T> out(std::move(q.front()));
+        q.pop_front();
+        wake(tx_parked);
+        return out;
+    }
+
+    void park_rx() { rx_parked = true; }
+    void park_tx(rio::internals::inbox *) { tx_parked = true; }
+
+    [[nodiscard]] auto rx_closed() const -> bool { return senders == 0; }
+    [[nodiscard]] auto tx_closed() const -> bool { return !rx_alive; }
+    [[nodiscard]] auto size() const -> std::size_t { return q.size(); }
+
+    void rebind_rx(rio::internals::inbox *h) { home = h; }
+
+    void add_sender()
+    {
+        ++senders;
+        ++refs;
+    }
+
+    void drop_sender()
+    {
+        if (--senders == 0)
+            wake(rx_parked);
+        release();
+    }
+
+    void drop_receiver()
+    {
+        rx_alive = false;
+        wake(tx_parked);
+        release();
+    }
+
+private:
+    void wake(bool &parked)
+    {
+        if (!std::exchange(parked, false))
+            return;
+        if (home)
+            home->wake();
+    }
+
+    void release()
+    {
+        if (--refs == 0)
+            delete this;
+    }
+};
+
+}  // namespace detail
+
+// Sending end. Copyable: every copy counts as a sender, the channel closes for the receiver when the last one goes.
+// bind(ctx) (or send(ctx, v)) names the context this copy sends from, so a send parked on a full channel is woken there.
+export template <typename S>
+struct sender
+{
+    using value_type = typename S::value_type;
+
+    S *st = nullptr;
+    rio::internals::inbox *home = nullptr;
+
+    sender(S *s, rio::internals::inbox *h) : st(s), home(h) {}
+    sender(const sender &other) : st(other.st), home(other.home)
+    {
+        if (st)
+            st->add_sender();
+    }
+    sender(sender &&other) noexcept : st(std::exchange(other.st, nullptr)), home(other.home) {}
+    sender &operator=(sender other) noexcept
+    {
+        std::swap(st, other.st);
+        std::swap(home, other.home);
+        return *this;
+    }
+    ~sender()
+    {
+        if (st)
+            st->drop_sender();
+    }
+
+    auto bind(rio::context &ctx) -> sender &
+    {
+        home = ctx.mailbox.get();
+        return *this;
+    }
+
+    // Moves from v only when it returns ok.
+    auto try_send(value_type &v) -> chan_status { return st->try_push(v); }
+
+    // Resolves once the value is queued, waits while the channel is full. Errors with broken_pipe once the
+    // receiver is gone. The sender must outlive the future.
+    auto send(value_type v)
+    {
+        struct op
+        {
+            sender *tx;
+            std::optional<value_type> v;
+        };
+
+        return rio::Future(op{this, std::move(v)}, [](op &o) -> fut::res<void> {
+            if (!o.v)
+                return fut::res<void>::ready();
+
+            auto r = o.tx->st->try_push(*o.v);
+            if (r == chan_status::full)
+            {
+                o.tx->st->park_tx(o.tx->home);
+                r = o.tx->st->try_push(*o.v);
+            }
+
+            switch (r)
+            {
+            case chan_status::ok: o.v.reset(); return fut::res<void>::ready();
+            case chan_status::closed: return fut::res<void>::error(std::errc::broken_pipe);
+            case chan_status::full: break;
+            }
+            return fut::res<void>::pending();
+        });
+    }
+
+    // send(v) from `ctx`'s thread, binding this sender there first.
+    auto send(rio::context &ctx, value_type v)
+    {
+        bind(ctx);
+        return send(std::move(v));
+    }
+
+    [[nodiscard]] auto closed() const -> bool { return st->tx_closed(); }
+};
+
+// Receiving end, one per channel, move-only. It belongs to the context it was created (or last bound) with.
+export template <typename S>
+struct receiver
+{
+    using value_type = typename S::value_type;
+
+    S *st = nullptr;
+
+    explicit receiver(S *s) : st(s) {}
+    receiver(receiver &&other) noexcept : st(std::exchange(other.st, nullptr)) {}
+    receiver &operator=(receiver &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (st)
+                st->drop_receiver();
+            st = std::exchange(other.st, nullptr);
+        }
+        return *this;
+    }
+    receiver(const receiver &) = delete;
+    receiver &operator=(const receiver &) = delete;
+    ~receiver()
+    {
+        if (st)
+            st->drop_receiver();
+    }
+
+    // Moves the receiving side to `ctx`, call it from ctx's thread before polling there.
+    auto bind(rio::context &ctx) -> receiver &
+    {
+        st->rebind_rx(ctx.mailbox.get());
+        return *this;
+    }
+
+    auto try_recv() -> std::optional<value_type> { return st->try_pop(); }
+
+    // Next value, errors with broken_pipe once every sender is gone and the queue is drained.
+    // The receiver must outlive the future.
+    auto recv()
+    {
+        return rio::Future(this, [](receiver *rx) -> fut::res<value_type> {
+            if (auto v = rx->pop_or_park())
+                return fut::res<value_type>::ready(std::move(*v));
+            return rx->drained();
+        });
+    }
+
+    // Everything queued, up to `max`, once at least one value is there. Same close semantics as recv().
+    auto recv_many(std::size_t max)
+    {
+        struct op
+        {
+            receiver *rx;
+            std::size_t max;
+        };
+
+        return rio::Future(op{this, std::max<std::size_t>(max, 1)}, [](op &o) -> fut::res<std::vector<value_type>> {
+            using R = fut::res<std::vector<value_type>>;
+
+            auto first = o.rx->pop_or_park();
+            if (!first)
+            {
+                auto r = o.rx->drained();
+                if (r.state != fut::status::ready)
+                    return r.state == fut::status::error ? R::error(r.err) : R::pending();
+                first = std::move(r.value);
+            }
+
+            std::vector<value_type> out;
+            out.reserve(std::min(o.max, o.rx->st->size() + 1));
+            out.push_back(std::move(*first));
+            while (out.size() < o.max)
+            {
+                auto v = o.rx->st->try_pop();
+                if (!v)
+                    break;
+                out.push_back(std::move(*v));
+            }
+            return R::ready(std::move(out));
+        });
+    }
+
+    [[nodiscard]] auto closed() const -> bool { return st->rx_closed(); }
+    [[nodiscard]] auto size() const -> std::size_t { return st->size(); }
+
+private:
+    auto pop_or_park() -> std::optional<value_type>
+    {
+        if (auto v = st->try_pop())
+            return v;
+        st->park_rx();
+        return st->try_pop();
+    }
+
+    // Queue looked empty: pending, or closed once no sender is left. The last sends land before the close.
+    auto drained() -> fut::res<value_type>
+    {
+        if (!st->rx_closed())
+            return fut::res<value_type>::pending();
+        if (auto v = st->try_pop())
+            return fut::res<value_type>::ready(std::move(*v));
+        return fut::res<value_type>::error(std::errc::broken_pipe);
+    }
+};
+
+export template <typename T> using local_sender = sender<detail::local_state<T>>;
+export template <typename T> using local_receiver = receiver<detail::local_state<T>>;
+export template <typename T> using bounded_sender = sender<detail::atomic_state<T, detail::bounded_ring<T>>>;
+export template <typename T> using bounded_receiver = receiver<detail::atomic_state<T, detail::bounded_ring<T>>>;
+export template <typename T> using unbounded_sender = sender<detail::atomic_state<T, detail::unbounded_list<T>>>;
+export template <typename T> using unbounded_receiver = receiver<detail::atomic_state<T, detail::unbounded_list<T>>>;
+
+// Single-thread channel between futures on `ctx`. capacity == 0 means unbounded.
+export template <typename T>
+auto local_channel(rio::context &ctx, std::size_t capacity = 0)
+{
+    auto *s = new detail::local_state<T>(ctx.mailbox.get(), capacity);
+    return std::pair{local_sender<T>{s, s->home}, local_receiver<T>{s}};
+}
+
+// Lock-free cross-thread channel holding at most `capacity` values, a full channel parks senders (backpressure).
+// The receiver lives on `rx_ctx`, the first sender is bound to `tx_ctx`. Copies keep that binding, a copy moved
+// to another thread should bind() there (or send through send(ctx, v)) so its parked sends are woken there.
+export template <typename T>
+auto channel(rio::context &rx_ctx, rio::context &tx_ctx, std::size_t capacity)
+{
+    auto *s = new detail::atomic_state<T, detail::bounded_ring<T>>(rx_ctx.mailbox.get(), capacity);
+    return std::pair{bounded_sender<T>{s, tx_ctx.mailbox.get()}, bounded_receiver<T>{s}};
+}
+
+// Lock-free cross-thread channel that never blocks senders, one allocation per message.
+export template <typename T>
+auto unbounded_channel(rio::context &rx_ctx)
+{
+    auto *s = new detail::atomic_state<T, detail::unbounded_list<T>>(rx_ctx.mailbox.get(), 0);
+    return std::pair{unbounded_sender<T>{s, nullptr}, unbounded_receiver<T>{s}};
+}
+
+}  // namespace rio::fut
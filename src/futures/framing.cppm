@@ -0,0 +1,316 @@
+module;
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+
+export module rio:fut.framing;
+
+import std;
+import :utils;
+import :utils.simd;
+import :handle;
+import :context;
+import :futures;
+import :fut.io;
+import :fut.pipeline;
+
+namespace rio::fut {
+
+// Byte ring for stream input, mapped twice back to back (like shm_channel's data pages): the free space and
+// the unread bytes are always one contiguous span, so frames that wrap need no copy and the buffer never compacts.
+export struct frame_buffer
+{
+    static auto create(std::size_t capacity = 64 * 1024) -> result<frame_buffer>;
+
+    frame_buffer() = default;
+    frame_buffer(frame_buffer &&other) noexcept
+        : base(std::exchange(other.base, nullptr)), cap(other.cap), head(other.head), tail(other.tail) {}
+    frame_buffer &operator=(frame_buffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            base = std::exchange(other.base, nullptr);
+            cap = other.cap, head = other.head, tail = other.tail;
+        }
+        return *this;
+    }
+    ~frame_buffer() { unmap(); }
+
+    [[nodiscard]] auto capacity() const -> std::size_t { return cap; }
+    [[nodiscard]] auto size() const -> std::size_t { return tail - head; }
+    [[nodiscard]] auto full() const -> bool { return size() == cap; }
+
+    // Unread bytes, valid until the next consume().
+    [[nodiscard]] auto data() const -> std::span<const char> { return {base + head % cap, size()}; }
+    // Where the next read goes, commit() what it filled.
+    [[nodiscard]] auto free_space() -> std::span<char> { return {base + tail % cap, cap - size()}; }
+
+    void commit(std::size_t n) { tail += n; }
+    void consume(std::size_t n)
+    {
+        head += n;
+        if (head == tail)
+            head = tail = 0;
+    }
+
+private:
+    void unmap()
+    {
+        if (base)
+            ::munmap(base, 2 * cap);
+        base = nullptr;
+    }
+
+    char *base = nullptr;
+    std::size_t cap = 0;
+    std::uint64_t head = 0, tail = 0;
+};
+
+auto frame_buffer::create(std::size_t capacity) -> result<frame_buffer>
+{
+    const auto pg = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    capacity = std::max(pg, (capacity + pg - 1) / pg * pg);
+
+    rio::handle fd(::memfd_create("rio-frame-buffer", MFD_CLOEXEC));
+    if (!fd)
+        return std::unexpected(Err::sys("memfd_create failed"));
+    if (::ftruncate(fd.native_handle(), static_cast<off_t>(capacity)) == -1)
+        return std::unexpected(Err::sys("Failed to size frame_buffer memfd"));
+
+    auto b = map_mirrored(fd.native_handle(), 0, capacity);
+    if (!b)
+        return std::unexpected(b.error());
+
+    // The mappings keep the memory alive, the fd is not needed past this point.
+    frame_buffer out;
+    out.base = reinterpret_cast<char *>(*b);
+    out.cap = capacity;
+    return out;
+}
+
+// Splits a byte stream into frames. decode() returns a view into `in` (no copy) plus how much of `in` it used,
+// encode() appends one framed payload. Any framer is a client_codec through framed_codec.
+export template <typename F>
+concept framer = requires(F &f, std::span<const char> in, std::span<const char> payload, std::string &out) {
+    { f.decode(in) } -> std::same_as<rio::result<decoded<std::span<const char>>>>;
+    { f.encode(payload, out) };
+};
+
+namespace detail {
+
+inline auto too_large(std::size_t n, std::size_t max) -> rio::Err
+{
+    return Err::app(std::errc::message_size, std::format("Frame of {} bytes over the {} byte limit", n, max));
+}
+
+}  // namespace detail
+
+// Payload preceded by its length as an unsigned `Len` in `Order`.
+export template <std::unsigned_integral Len = std::uint32_t, std::endian Order = std::endian::big>
+struct length_prefixed
+{
+    std::size_t max_frame = 16 << 20;
+
+    auto decode(std::span<const char> in) const -> rio::result<decoded<std::span<const char>>>
+    {
+        if (in.size() < sizeof(Len))
+            return decoded<std::span<const char>>{};
+
+        Len len;
+        std::memcpy(&len, in.data(), sizeof(Len));
+        if constexpr (Order != std::endian::native)
+            len = std::byteswap(len);
+
+        if (len > max_frame)
+            return std::unexpected(detail::too_large(len, max_frame));
+        if (in.size() - sizeof(Len) < len)
+            return decoded<std::span<const char>>{};
+        return decoded<std::span<const char>>{.consumed = sizeof(Len) + len, .value = in.subspan(sizeof(Len), len)};
+    }
+
+    void encode(std::span<const char> payload, std::string &out) const
+    {
+        auto len = static_cast<Len>(payload.size());
+        if constexpr (Order != std::endian::native)
+            len = std::byteswap(len);
+        char b[sizeof(Len)];
+        std::memcpy(b, &len, sizeof(Len));
+        out.append(b, sizeof(Len));
+        out.append(payload.data(), payload.size());
+    }
+};
+
+export using length_prefixed_be = length_prefixed<std::uint32_t, std::endian::big>;
+export using length_prefixed_le = length_prefixed<std::uint32_t, std::endian::little>;
+
+// Frames end with `delim`, which is not part of the view. The scan is rio::simd::find.
+// Like io::buffered_reader it remembers how far it scanned without a hit, so a frame arriving in many reads
+// is scanned once: one delimited per stream, fed the unconsumed bytes each time.
+export struct delimited
+{
+    char delim = '\n';
+    std::size_t max_frame = 64 * 1024;
+
+    auto decode(std::span<const char> in) -> rio::result<decoded<std::span<const char>>>
+    {
+        if (scanned > in.size())
+            scanned = 0;
+
+        const char *end = in.data() + in.size();
+        const char *hit = rio::simd::find(in.data() + scanned, end, delim);
+        if (hit == end)
+        {
+            if (in.size() > max_frame)
+                return std::unexpected(detail::too_large(in.size(), max_frame));
+            scanned = in.size();
+            return decoded<std::span<const char>>{};
+        }
+
+        scanned = 0;
+        const auto len = static_cast<std::size_t>(hit - in.data());
+        if (len > max_frame)
+            return std::unexpected(detail::too_large(len, max_frame));
+        return decoded<std::span<const char>>{.consumed = len + 1, .value = in.first(len)};
+    }
+
+    void encode(std::span<const char> payload, std::string &out) const
+    {
+        out.append(payload.data(), payload.size());
+        out.push_back(delim);
+    }
+
+private:
+    std::size_t scanned = 0;  // Leading bytes of the unconsumed input known to hold no delimiter
+};
+
+// Every frame is exactly `size` bytes. encode() pads short payloads with zeros and cuts long ones.
+export struct fixed_size
+{
+    std::size_t size = 0;
+
+    auto decode(std::span<const char> in) const -> rio::result<decoded<std::span<const char>>>
+    {
+        if (size == 0)
+            return std::unexpected(Err::app(std::errc::invalid_argument, "fixed_size framer needs a size"));
+        if (in.size() < size)
+            return decoded<std::span<const char>>{};
+        return decoded<std::span<const char>>{.consumed = size, .value = in.first(size)};
+    }
+
+    void encode(std::span<const char> payload, std::string &out) const
+    {
+        const auto n = std::min(payload.size(), size);
+        out.append(payload.data(), n);
+        out.append(size - n, '\0');
+    }
+};
+
+// Frames read off a stream through one frame_buffer: read() refills it, for_each() hands out every complete
+// frame as a view into the buffer, so one read yields as many pipelined messages as it carried.
+export template <framer F>
+struct framed_reader
+{
+    frame_buffer buf;
+    F framing;
+
+    framed_reader(frame_buffer b, F f) : buf(std::move(b)), framing(std::move(f)) {}
+
+    static auto create(F f = {}, std::size_t capacity = 64 * 1024) -> result<framed_reader>
+    {
+        auto b = frame_buffer::create(capacity);
+        if (!b)
+            return std::unexpected(b.error());
+        return framed_reader{std::move(*b), std::move(f)};
+    }
+
+    // Ring read into the free space, resolves with the bytes read (0: peer closed). Fails with message_size when
+    // the buffer is full without a complete frame: capacity must hold the largest frame.
+    // The reader must stay at its address until the future resolves.
+    auto read(rio::context &ctx, int fd)
+    {
+        auto space = buf.free_space();
+        return rio::fut::read(ctx, fd, space).then([this, full = space.empty()](std::size_t n) {
+            buf.commit(n);
+            return rio::fut::make(n, [full](std::size_t n) {
+                return full ? fut::res<std::size_t>::error(std::errc::message_size) : fut::res<std::size_t>::ready(n);
+            });
+        });
+    }
+
+    template <typename HandleT>
+    requires requires(HandleT h) { h.fd.native_handle(); }
+    auto read(rio::context &ctx, HandleT &h)
+    {
+        return read(ctx, h.fd.native_handle());
+    }
+
+    // Next complete frame, nullopt when the buffer holds none. The view lives until the next next()/for_each().
+    auto next() -> rio::result<std::optional<std::span<const char>>>
+    {
+        if (pending)
+            buf.consume(std::exchange(pending, 0));
+
+        while (buf.size())
+        {
+            auto d = framing.decode(buf.data());
+            if (!d)
+                return std::unexpected(d.error());
+            if (d->value)
+            {
+                pending = d->consumed;
+                return d->value;
+            }
+            if (d->consumed == 0)
+                break;
+            buf.consume(d->consumed);
+        }
+        return std::nullopt;
+    }
+
+    // Calls fn(span<const char>) for every complete frame in the buffer, returns how many.
+    template <typename Fn>
+    requires std::invocable<Fn &, std::span<const char>>
+    auto for_each(Fn &&fn) -> rio::result<std::size_t>
+    {
+        std::size_t n = 0;
+        while (true)
+        {
+            auto f = next();
+            if (!f)
+                return std::unexpected(f.error());
+            if (!*f)
+                return n;
+            fn(**f);
+            ++n;
+        }
+    }
+
+private:
+    std::size_t pending = 0;  // Bytes of the frame last handed out, consumed on the next call
+};
+
+// Any framer as a pipeline_client codec: payloads in, owned payload copies out, matched in send order.
+export template <framer F>
+struct framed_codec
+{
+    using request = std::string;
+    using response = std::string;
+
+    F framing{};
+
+    void encode(const request &rq, std::uint64_t, std::string &out) { framing.encode(rq, out); }
+
+    auto decode(std::span<const char> in) -> rio::result<decoded<response>>
+    {
+        auto d = framing.decode(in);
+        if (!d)
+            return std::unexpected(d.error());
+        if (!d->value)
+            return decoded<response>{.consumed = d->consumed};
+        return decoded<response>{.consumed = d->consumed, .value = std::string(d->value->begin(), d->value->end())};
+    }
+};
+
+}  // namespace rio::fut
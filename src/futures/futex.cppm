@@ -0,0 +1,190 @@
+module;
+#include <liburing.h>
+#include <linux/futex.h>
+#include <cerrno>
+#include "../ring_futex.hpp"
+
+export module rio:fut.futex;
+
+import std;
+import :utils;
+import :context;
+import :promise;
+import :futures;
+import :fut.io;
+
+// Futex wait/wake as ring ops (IORING_OP_FUTEX_WAIT/WAKE, kernel 6.7+): a shard can wait on a word shared with
+// plain threads (or other processes, shared = true) without parking a helper thread on it.
+// Without kernel/liburing support every op fails with function_not_supported, check context::has_ring_futex().
+
+namespace rio::internals {
+
+inline auto futex_flags(bool shared) -> std::uint32_t { return FUTEX2_SIZE_U32 | (shared ? 0u : FUTEX2_PRIVATE); }
+
+inline auto futex_addr(std::atomic<std::uint32_t> &word) -> std::uint32_t * { return reinterpret_cast<std::uint32_t *>(&word); }
+
+// Wait completions: 0 woken, -EAGAIN the word no longer held `expected`. Both mean "go look at the word".
+inline auto futex_wait_res(int res) -> int { return res == -EAGAIN ? 0 : res; }
+
+}  // namespace rio::internals
+
+namespace rio::fut {
+
+struct Futex_wait_req
+{
+    rio::internals::uring_request_header header;
+    Async_state<void> *state;
+
+    static void on_complete(rio::internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<Futex_wait_req *>(ptr);
+        rio::Promise<Async_state<void>> p{.state = self->state};
+        if (int r = rio::internals::futex_wait_res(res); r < 0)
+            p.reject(std::error_code(-r, std::system_category()));
+        else
+            p.resolve();
+        self->state->io_done = true;
+        if (self->state->future_dropped)
+            delete self->state;
+        delete self;
+    }
+};
+
+template <typename T>
+auto unsupported_op()
+{
+    auto *s = new Async_state<T>();
+    s->reject(std::make_error_code(std::errc::function_not_supported));
+    s->io_done = true;
+    return rio::Future(Async_handle<T>{s}, Async_poller{});
+}
+
+// Resolves once `word` is woken, or right away if it no longer holds `expected`. Re-check the word after:
+// spurious wakeups are allowed. `word` must stay alive until the future resolves.
+export auto futex_wait(rio::context &ctx, std::atomic<std::uint32_t> &word, std::uint32_t expected, bool shared = false)
+{
+#if RIO_HAS_RING_FUTEX
+    if (!ctx.has_ring_futex())
+        return unsupported_op<void>();
+
+    auto *s = new Async_state<void>();
+    auto *req = new Futex_wait_req{.header = {.call = &Futex_wait_req::on_complete}, .state = s};
+    auto *sqe = ctx.sqe();
+    io_uring_prep_futex_wait(sqe, rio::internals::futex_addr(word), expected, FUTEX_BITSET_MATCH_ANY, rio::internals::futex_flags(shared), 0);
+    io_uring_sqe_set_data(sqe, &req->header);
+    ctx.submit();
+    return rio::Future(Async_handle<void>{s}, Async_poller{});
+#else
+    (void)ctx, (void)word, (void)expected, (void)shared;
+    return unsupported_op<void>();
+#endif
+}
+
+// Wakes up to `count` waiters on `word` (ring or plain futex waiters alike), resolves with how many woke.
+export auto futex_wake(rio::context &ctx, std::atomic<std::uint32_t> &word, std::uint32_t count = 1, bool shared = false)
+{
+    using ValType = std::size_t;
+#if RIO_HAS_RING_FUTEX
+    if (!ctx.has_ring_futex())
+        return unsupported_op<ValType>();
+
+    auto *s = new Async_state<ValType>();
+    auto *req = new Uring_req<ValType>{.header = {.call = &Uring_req<ValType>::on_complete}, .state = s};
+    auto *sqe = ctx.sqe();
+    io_uring_prep_futex_wake(sqe, rio::internals::futex_addr(word), count, FUTEX_BITSET_MATCH_ANY, rio::internals::futex_flags(shared), 0);
+    io_uring_sqe_set_data(sqe, &req->header);
+    ctx.submit();
+    return rio::Future(Async_handle<ValType>{s}, Async_poller{});
+#else
+    (void)ctx, (void)word, (void)count, (void)shared;
+    return unsupported_op<ValType>();
+#endif
+}
+
+}  // namespace rio::fut
+
+namespace rio::as {
+
+template <typename Fn, typename T>
+concept On_Futex_Wait_CB_C = std::invocable<Fn, rio::context &, rio::result<void>, T *>;
+
+template <typename Fn, typename T>
+concept On_Futex_Wake_CB_C = std::invocable<Fn, rio::context &, rio::result<std::size_t>, T *>;
+
+template <typename Fn, typename User_data, bool Wait>
+struct uring_futex_request
+{
+    internals::uring_request_header header;
+
+    rio::context &context;
+    User_data *user_data;
+    Fn callback;
+
+    static void on_complete(internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<uring_futex_request *>(ptr);
+
+        if constexpr (Wait)
+        {
+            if (int r = internals::futex_wait_res(res); r < 0)
+                self->callback(self->context, rio::result<void>(std::unexpected(rio::Err{-r, "Futex wait failed"})), self->user_data);
+            else
+                self->callback(self->context, rio::result<void>{}, self->user_data);
+        }
+        else
+        {
+            if (res < 0)
+                self->callback(self->context, std::unexpected(rio::Err{-res, "Futex wake failed"}), self->user_data);
+            else
+                self->callback(self->context, static_cast<std::size_t>(res), self->user_data);
+        }
+
+        delete self;
+    }
+};
+
+// Callback flavours of fut::futex_wait/futex_wake. Without ring futex support the callback runs inline
+// with function_not_supported.
+export template <typename T, typename Fn>
+requires On_Futex_Wait_CB_C<Fn, T>
+void futex_wait(rio::context &context, std::atomic<std::uint32_t> &word, std::uint32_t expected, Fn &&on_wake, T *user, bool shared = false)
+{
+#if RIO_HAS_RING_FUTEX
+    if (context.has_ring_futex())
+    {
+        auto *sqe = context.sqe();
+        using request_type = uring_futex_request<std::decay_t<Fn>, T, true>;
+        auto *req = new request_type{.header = {.call = &request_type::on_complete}, .context = context, .user_data = user, .callback = std::forward<Fn>(on_wake)};
+
+        io_uring_prep_futex_wait(sqe, internals::futex_addr(word), expected, FUTEX_BITSET_MATCH_ANY, internals::futex_flags(shared), 0);
+        io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&req->header));
+        context.submit();
+        return;
+    }
+#endif
+    (void)word, (void)expected, (void)shared;
+    on_wake(context, rio::result<void>(std::unexpected(rio::Err::app(std::errc::function_not_supported, "Ring futex ops not supported"))), user);
+}
+
+export template <typename T, typename Fn>
+requires On_Futex_Wake_CB_C<Fn, T>
+void futex_wake(rio::context &context, std::atomic<std::uint32_t> &word, std::uint32_t count, Fn &&on_woken, T *user, bool shared = false)
+{
+#if RIO_HAS_RING_FUTEX
+    if (context.has_ring_futex())
+    {
+        auto *sqe = context.sqe();
+        using request_type = uring_futex_request<std::decay_t<Fn>, T, false>;
+        auto *req = new request_type{.header = {.call = &request_type::on_complete}, .context = context, .user_data = user, .callback = std::forward<Fn>(on_woken)};
+
+        io_uring_prep_futex_wake(sqe, internals::futex_addr(word), count, FUTEX_BITSET_MATCH_ANY, internals::futex_flags(shared), 0);
+        io_uring_sqe_set_data(sqe, static_cast<internals::uring_request_header *>(&req->header));
+        context.submit();
+        return;
+    }
+#endif
+    (void)word, (void)count, (void)shared;
+    on_woken(context, rio::result<std::size_t>(std::unexpected(rio::Err::app(std::errc::function_not_supported, "Ring futex ops not supported"))), user);
+}
+
+}  // namespace rio::as
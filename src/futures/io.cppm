@@ -1,12 +1,14 @@
 module;
 #include <liburing.h>
 #include <sys/socket.h>
+#include <cerrno>
 
 export module rio:fut.io;
 
 import std;
 import :context;
 import :socket;
+import :socket.unix_socket;
 import :promise;
 import :futures;
 
@@ -18,12 +20,20 @@ struct Async_poller
     auto operator()(HandleType &h) const { return h.poll(); }
 };
 
-export struct Accept_result
+export template <typename Sock>
+struct basic_accept_result
 {
-    rio::Tcp_socket client;
+    Sock client;
     rio::address address;
 };
 
+export using Accept_result = basic_accept_result<rio::Tcp_socket>;
+export using Unix_accept_result = basic_accept_result<rio::Unix_socket>;
+
+// Listening sockets accept() works on, the accepted connection comes back as the same type.
+template <typename Sock>
+concept Listener_C = std::same_as<Sock, rio::Tcp_socket> || std::same_as<Sock, rio::Unix_socket>;
+
 template <typename T>
 struct Async_state : public rio::promise::State<T>
 {
@@ -94,22 +104,25 @@ struct Uring_req
     }
 };
 
+template <typename Sock>
 struct Accept_req
 {
+    using Result = basic_accept_result<Sock>;
+
     rio::internals::uring_request_header header;
-    Async_state<Accept_result> *state;
+    Async_state<Result> *state;
     rio::address client_addr;
     socklen_t addr_len = sizeof(sockaddr_storage);
     static void on_complete(rio::internals::uring_request_header *ptr, int res)
     {
         auto *self = reinterpret_cast<Accept_req *>(ptr);
-        rio::Promise<Async_state<Accept_result>> p{.state = self->state};
+        rio::Promise<Async_state<Result>> p{.state = self->state};
         if (res < 0)
             p.reject(std::error_code(-res, std::system_category()));
         else
         {
             self->client_addr.len = self->addr_len;
-            p.resolve(Accept_result{.client = rio::Tcp_socket::attach(res), .address = self->client_addr});
+            p.resolve(Result{.client = Sock::attach(res), .address = self->client_addr});
         }
         self->state->io_done = true;
         if (self->state->future_dropped)
@@ -153,11 +166,34 @@ auto write(rio::context &ctx, HandleT &h, std::span<const char> buf)
     return write(ctx, h.fd.native_handle(), buf);
 }
 
-export auto accept(rio::context &ctx, rio::Tcp_socket &listener)
+// Gathers `iov` into one write. The iovecs and the memory they point to must stay alive until the future resolves.
+export auto writev(rio::context &ctx, int fd, std::span<const iovec> iov)
+{
+    using ValType = std::size_t;
+    auto *s = new Async_state<ValType>();
+    auto *req = new Uring_req<ValType>{.header = {.call = &Uring_req<ValType>::on_complete}, .state = s};
+    auto *sqe = ctx.sqe();
+    io_uring_prep_writev(sqe, fd, iov.data(), static_cast<unsigned>(iov.size()), 0);
+    io_uring_sqe_set_data(sqe, &req->header);
+    ctx.submit();
+    return rio::Future(Async_handle{s}, Async_poller{});
+}
+
+export template <typename HandleT>
+requires requires(HandleT h) { h.fd.native_handle(); }
+auto writev(rio::context &ctx, HandleT &h, std::span<const iovec> iov)
+{
+    return writev(ctx, h.fd.native_handle(), iov);
+}
+
+// Resolves with an Accept_result for a Tcp_socket listener, a Unix_accept_result for a Unix_socket one.
+export template <Listener_C Sock>
+auto accept(rio::context &ctx, Sock &listener)
 {
-    using ValType = Accept_result;
+    using Req = Accept_req<Sock>;
+    using ValType = typename Req::Result;
     auto *s = new Async_state<ValType>();
-    auto *req = new Accept_req{.header = {.call = &Accept_req::on_complete}, .state = s, .client_addr = {}, .addr_len = sizeof(sockaddr_storage)};
+    auto *req = new Req{.header = {.call = &Req::on_complete}, .state = s, .client_addr = {}, .addr_len = sizeof(sockaddr_storage)};
     auto *sqe = ctx.sqe();
     io_uring_prep_accept(sqe, listener.fd.native_handle(), reinterpret_cast<sockaddr *>(&req->client_addr.storage), &req->addr_len, 0);
     io_uring_sqe_set_data(sqe, &req->header);
@@ -199,6 +235,200 @@ struct Timer_req
     }
 };
 
+struct Cancel_req
+{
+    rio::internals::uring_request_header header;
+    Async_state<std::size_t> *state;
+
+    static void on_complete(rio::internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<Cancel_req *>(ptr);
+        rio::Promise<Async_state<std::size_t>> p{.state = self->state};
+
+        // -ENOENT: nothing was in flight on the fd, which is what the caller wanted anyway.
+        if (res == -ENOENT)
+            p.resolve(0);
+        else if (res < 0)
+            p.reject(std::error_code(-res, std::system_category()));
+        else
+            p.resolve(static_cast<std::size_t>(res));
+
+        self->state->io_done = true;
+        if (self->state->future_dropped)
+            delete self->state;
+        delete self;
+    }
+};
+
+// Cancels every op in flight on `fd` in this ring, resolves with how many were cancelled.
+// Their own futures/callbacks complete with ECANCELED. Used to quiesce a socket before it leaves the ring.
+export auto cancel_fd(rio::context &ctx, int fd)
+{
+    auto *s = new Async_state<std::size_t>();
+    auto *req = new Cancel_req{.header = {.call = &Cancel_req::on_complete}, .state = s};
+    auto *sqe = ctx.sqe();
+    io_uring_prep_cancel_fd(sqe, fd, IORING_ASYNC_CANCEL_ALL);
+    io_uring_sqe_set_data(sqe, &req->header);
+    ctx.submit();
+    return rio::Future(Async_handle{s}, Async_poller{});
+}
+
+struct Connect_req
+{
+    rio::internals::uring_request_header header;
+    Async_state<rio::Tcp_socket> *state;
+    rio::Tcp_socket sock;
+    rio::address addr;
+    __kernel_timespec ts{};
+    bool timed = false;  // A link timeout was armed
+
+    static void on_complete(rio::internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<Connect_req *>(ptr);
+        rio::Promise<Async_state<rio::Tcp_socket>> p{.state = self->state};
+
+        // -ECANCELED with a link timeout armed: it fired first. Otherwise it stays operation_canceled (cancel_fd...).
+        if (res == -ECANCELED && self->timed)
+            p.reject(std::make_error_code(std::errc::timed_out));
+        else if (res < 0)
+            p.reject(std::error_code(-res, std::system_category()));
+        else
+            p.resolve(std::move(self->sock));
+
+        self->state->io_done = true;
+        if (self->state->future_dropped)
+            delete self->state;
+        delete self;
+    }
+};
+
+// Opens a socket for `addr` (family from the address, the rest from `options`) and connects it on the ring.
+// A non-zero `timeout` is linked to the connect (IORING_OP_LINK_TIMEOUT) and fails it with timed_out.
+export auto connect(rio::context &ctx, const rio::address &addr, s_opt options = s_opt::client,
+                    std::chrono::nanoseconds timeout = std::chrono::nanoseconds::zero())
+{
+    auto *s = new Async_state<rio::Tcp_socket>();
+
+    auto sock = rio::internals::client_socket(addr, options);
+    if (!sock)
+    {
+        s->reject(sock.error().code);
+        s->io_done = true;
+        return rio::Future(Async_handle{s}, Async_poller{});
+    }
+
+    // The connect and its timeout have to go out in one submit for the link to hold.
+    if (io_uring_sq_space_left(&ctx.ring) < 2)
+        ctx.submit();
+
+    auto *sqe = ctx.sqe();
+    if (!sqe)
+    {
+        s->reject(std::make_error_code(std::errc::resource_unavailable_try_again));
+        s->io_done = true;
+        return rio::Future(Async_handle{s}, Async_poller{});
+    }
+
+    auto *req = new Connect_req{.header = {.call = &Connect_req::on_complete}, .state = s, .sock = std::move(*sock), .addr = addr};
+    io_uring_prep_connect(sqe, req->sock.fd.native_handle(), req->addr.data(), req->addr.size());
+    io_uring_sqe_set_data(sqe, &req->header);
+
+    if (timeout > std::chrono::nanoseconds::zero())
+    {
+        io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+        req->ts = {.tv_sec = timeout.count() / 1'000'000'000, .tv_nsec = timeout.count() % 1'000'000'000};
+        req->timed = true;
+        // No completion handler: its CQE (timer fired or cancelled by the connect) carries no user data.
+        auto *t = ctx.sqe();
+        io_uring_prep_link_timeout(t, &req->ts, 0);
+        io_uring_sqe_set_data(t, nullptr);
+    }
+
+    ctx.submit();
+    return rio::Future(Async_handle{s}, Async_poller{});
+}
+
+// sendmsg/recvmsg with SCM_RIGHTS. The msghdr and control buffer live in the request until the CQE.
+struct Send_fds_req
+{
+    rio::internals::uring_request_header header;
+    Async_state<std::size_t> *state;
+    msghdr msg;
+    iovec iov;
+    rio::internals::fd_cmsg ctl;
+
+    static void on_complete(rio::internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<Send_fds_req *>(ptr);
+        rio::Promise<Async_state<std::size_t>> p{.state = self->state};
+        if (res < 0)
+            p.reject(std::error_code(-res, std::system_category()));
+        else
+            p.resolve(static_cast<std::size_t>(res));
+        self->state->io_done = true;
+        if (self->state->future_dropped)
+            delete self->state;
+        delete self;
+    }
+};
+
+struct Recv_fds_req
+{
+    rio::internals::uring_request_header header;
+    Async_state<rio::fd_message> *state;
+    msghdr msg;
+    iovec iov;
+    rio::internals::fd_cmsg ctl;
+
+    static void on_complete(rio::internals::uring_request_header *ptr, int res)
+    {
+        auto *self = reinterpret_cast<Recv_fds_req *>(ptr);
+        rio::Promise<Async_state<rio::fd_message>> p{.state = self->state};
+        if (res < 0)
+            p.reject(std::error_code(-res, std::system_category()));
+        else if (auto m = rio::internals::collect_fds(self->msg, static_cast<std::size_t>(res)); m)
+            p.resolve(std::move(*m));
+        else
+            p.reject(std::make_error_code(std::errc::message_size));  // fds that did arrive are already closed
+        self->state->io_done = true;
+        if (self->state->future_dropped)
+            delete self->state;
+        delete self;
+    }
+};
+
+// Ring version of rio::send_fds. `data` must stay alive until the future resolves, the fds are copied.
+export auto send_fds(rio::context &ctx, rio::Unix_socket &s, std::span<const char> data, std::span<const int> fds)
+{
+    auto *st = new Async_state<std::size_t>();
+    auto *req = new Send_fds_req{.header = {.call = &Send_fds_req::on_complete}, .state = st, .msg = {}, .iov = {}, .ctl = {}};
+    if (auto r = rio::internals::prep_fd_send(req->msg, req->iov, req->ctl, data, fds); !r)
+    {
+        delete req;
+        st->reject(std::make_error_code(std::errc::argument_list_too_long));
+        st->io_done = true;
+        return rio::Future(Async_handle{st}, Async_poller{});
+    }
+    auto *sqe = ctx.sqe();
+    io_uring_prep_sendmsg(sqe, s.fd.native_handle(), &req->msg, MSG_NOSIGNAL);
+    io_uring_sqe_set_data(sqe, &req->header);
+    ctx.submit();
+    return rio::Future(Async_handle{st}, Async_poller{});
+}
+
+// Ring version of rio::recv_fds, received fds are close-on-exec. `data` must stay alive until the future resolves.
+export auto recv_fds(rio::context &ctx, rio::Unix_socket &s, std::span<char> data)
+{
+    auto *st = new Async_state<rio::fd_message>();
+    auto *req = new Recv_fds_req{.header = {.call = &Recv_fds_req::on_complete}, .state = st, .msg = {}, .iov = {}, .ctl = {}};
+    rio::internals::prep_fd_recv(req->msg, req->iov, req->ctl, data);
+    auto *sqe = ctx.sqe();
+    io_uring_prep_recvmsg(sqe, s.fd.native_handle(), &req->msg, MSG_CMSG_CLOEXEC);
+    io_uring_sqe_set_data(sqe, &req->header);
+    ctx.submit();
+    return rio::Future(Async_handle{st}, Async_poller{});
+}
+
 export template <typename Rep, typename Period>
 auto wake_up_after(rio::context &ctx, std::chrono::duration<Rep, Period> d)
 {
@@ -0,0 +1,336 @@
+module;
+
+#include <sys/socket.h>
+
+export module rio:fut.pipeline;
+
+import std;
+import :utils;
+import :context;
+import :socket;
+import :asio;
+import :futures;
+import :fut.io;
+
+namespace rio::fut {
+
+// What a codec's decode() reports: `consumed` bytes were used up, `value` is set when they completed a message.
+// {0, nullopt} means the input holds no complete message yet.
+export template <typename T>
+struct decoded
+{
+    std::size_t consumed = 0;
+    std::optional<T> value = std::nullopt;
+};
+
+// Wire format of a request/response protocol. encode() appends one request (ordered codecs ignore `id`),
+// decode() parses at most one response from the front of `in`. Responses must own their bytes, the input
+// buffer is reused once decode returns.
+export template <typename C>
+concept client_codec = requires(C &c, const typename C::request &rq, std::uint64_t id, std::string &out, std::span<const char> in) {
+    typename C::request;
+    typename C::response;
+    { c.encode(rq, id, out) };
+    { c.decode(in) } -> std::same_as<rio::result<decoded<typename C::response>>>;
+};
+
+// Multiplexed protocols carry the request id back, responses may then come in any order.
+// Without id_of() responses are matched to requests in send order.
+export template <typename C>
+concept id_matched_codec = client_codec<C> && requires(const C &c, const typename C::response &r) {
+    { c.id_of(r) } -> std::convertible_to<std::uint64_t>;
+};
+
+export struct pipeline_options
+{
+    std::size_t read_buffer = 64 * 1024;
+    std::size_t max_in_flight = 4096;     // Calls past it fail with resource_unavailable_try_again
+    std::size_t max_response = 16 << 20;  // One undecoded response past it fails the connection with message_size
+};
+
+export struct pipeline_stats
+{
+    std::uint64_t calls = 0;
+    std::uint64_t responses = 0;
+    std::uint64_t writes = 0;    // Write ops issued, calls / writes is the coalescing factor
+    std::uint64_t orphaned = 0;  // Responses whose caller timed out or went away
+};
+
+namespace detail {
+
+template <typename Resp>
+struct call_slot
+{
+    std::optional<Resp> value;
+    std::error_code err;
+    bool done = false;
+};
+
+template <client_codec Codec>
+struct pipeline_core : std::enable_shared_from_this<pipeline_core<Codec>>
+{
+    using response = typename Codec::response;
+    using slot_ptr = std::shared_ptr<call_slot<response>>;
+
+    rio::context *ctx;
+    rio::Tcp_socket sock;
+    Codec codec;
+    pipeline_options opts;
+    pipeline_stats stats;
+
+    // Requests encoded since the last write went out, and the bytes of the write in flight.
+    std::string queued, writing;
+    std::size_t write_off = 0;
+    bool write_busy = false;
+    bool flush_posted = false;
+
+    std::vector<char> rbuf;
+    std::size_t head = 0, tail = 0;
+    bool read_busy = false;
+
+    std::uint64_t next_id = 1;
+    std::deque<std::weak_ptr<call_slot<response>>> in_order;                  // Ordered codecs
+    std::unordered_map<std::uint64_t, std::weak_ptr<call_slot<response>>> by_id;  // id_matched_codec
+    std::error_code broken;
+
+    pipeline_core(rio::context &c, rio::Tcp_socket s, Codec cd, pipeline_options o)
+        : ctx(&c), sock(std::move(s)), codec(std::move(cd)), opts(o), rbuf(std::max<std::size_t>(o.read_buffer, 512)) {}
+
+    [[nodiscard]] auto outstanding() const -> std::size_t
+    {
+        if constexpr (id_matched_codec<Codec>)
+            return by_id.size();
+        else
+            return in_order.size();
+    }
+
+    auto submit(const typename Codec::request &rq) -> slot_ptr
+    {
+        auto slot = std::make_shared<call_slot<response>>();
+        auto fail = [&](std::error_code ec) {
+            slot->err = ec;
+            slot->done = true;
+            return slot;
+        };
+
+        if (broken)
+            return fail(broken);
+        if (outstanding() >= opts.max_in_flight)
+            return fail(std::make_error_code(std::errc::resource_unavailable_try_again));
+
+        const auto id = next_id++;
+        codec.encode(rq, id, queued);
+        if constexpr (id_matched_codec<Codec>)
+            by_id.emplace(id, slot);
+        else
+            in_order.push_back(slot);
+        ++stats.calls;
+
+        // Requests made in the same loop turn leave in one write: the flush runs from the inbox, after them.
+        if (!write_busy && !flush_posted)
+        {
+            flush_posted = true;
+            ctx->post([self = this->shared_from_this()] {
+                self->flush_posted = false;
+                self->flush();
+            });
+        }
+        arm_read();
+        return slot;
+    }
+
+    void flush()
+    {
+        if (write_busy || broken)
+            return;
+        if (write_off == writing.size())
+        {
+            if (queued.empty())
+                return;
+            writing.clear();
+            std::swap(writing, queued);
+            write_off = 0;
+        }
+
+        write_busy = true;
+        ++stats.writes;
+        rio::as::write(*ctx, sock, std::span<const char>(writing).subspan(write_off),
+            [self = this->shared_from_this()](rio::context &, rio::result<std::size_t> n, pipeline_core *) {
+                self->write_busy = false;
+                if (!n)
+                    return self->fail_all(n.error().code);
+                self->write_off += *n;
+                self->flush();
+            },
+            this);
+    }
+
+    void arm_read()
+    {
+        if (read_busy || broken || outstanding() == 0)
+            return;
+
+        // Compact, and grow only when one message does not fit the whole buffer.
+        if (head == tail)
+            head = tail = 0;
+        else if (tail == rbuf.size() && head > 0)
+        {
+            std::memmove(rbuf.data(), rbuf.data() + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+        if (tail == rbuf.size())
+        {
+            if (rbuf.size() >= opts.max_response)
+                return fail_all(std::make_error_code(std::errc::message_size));
+            rbuf.resize(std::min(rbuf.size() * 2, opts.max_response));
+        }
+
+        read_busy = true;
+        rio::as::read(*ctx, sock, std::span<char>(rbuf).subspan(tail),
+            [self = this->shared_from_this()](rio::context &, rio::result<std::size_t> n, pipeline_core *) {
+                self->read_busy = false;
+                if (!n)
+                    return self->fail_all(n.error().code);
+                if (*n == 0)
+                    return self->fail_all(std::make_error_code(std::errc::connection_reset));
+                self->tail += *n;
+                self->dispatch();
+                self->arm_read();
+            },
+            this);
+    }
+
+    // Every complete response in the buffer goes to its caller, one read often carries many.
+    void dispatch()
+    {
+        while (head < tail)
+        {
+            auto d = codec.decode(std::span<const char>(rbuf.data() + head, tail - head));
+            if (!d)
+                return fail_all(d.error().code);
+            head += d->consumed;
+            if (!d->value)
+            {
+                if (d->consumed == 0)
+                    return;
+                continue;
+            }
+
+            ++stats.responses;
+            std::shared_ptr<call_slot<response>> slot;
+            if constexpr (id_matched_codec<Codec>)
+            {
+                auto it = by_id.find(static_cast<std::uint64_t>(codec.id_of(*d->value)));
+                if (it == by_id.end())
+                    return fail_all(std::make_error_code(std::errc::bad_message));
+                slot = it->second.lock();
+                by_id.erase(it);
+            }
+            else
+            {
+                if (in_order.empty())
+                    return fail_all(std::make_error_code(std::errc::bad_message));
+                slot = in_order.front().lock();
+                in_order.pop_front();
+            }
+
+            if (!slot)
+            {
+                ++stats.orphaned;
+                continue;
+            }
+            slot->value.emplace(std::move(*d->value));
+            slot->done = true;
+        }
+    }
+
+    // Fails everything outstanding with operation_canceled and shuts the socket down: the read (and write) in
+    // flight complete, drop their hold on the core, and it goes with the last one.
+    void close()
+    {
+        fail_all(std::make_error_code(std::errc::operation_canceled));
+        ::shutdown(sock.fd.native_handle(), SHUT_RDWR);
+    }
+
+    // The connection is unusable after any I/O or protocol error, everything outstanding fails with it.
+    void fail_all(std::error_code ec)
+    {
+        if (broken)
+            return;
+        broken = ec;
+        auto fail = [&](auto &weak) {
+            if (auto s = weak.lock(); s && !s->done)
+                s->err = ec, s->done = true;
+        };
+        for (auto &w : in_order) fail(w);
+        for (auto &[_, w] : by_id) fail(w);
+        in_order.clear();
+        by_id.clear();
+        queued.clear();
+    }
+};
+
+}  // namespace detail
+
+// Pipelined / multiplexed client over one connection. call() encodes the request and returns at once:
+// requests issued in the same loop turn are coalesced into one write, responses are decoded in batches
+// and matched by order or by id (see id_matched_codec). Bound to one context, like the socket's ring ops.
+// Move-only, dropping it close()s the connection.
+export template <client_codec Codec>
+struct pipeline_client
+{
+    using request = typename Codec::request;
+    using response = typename Codec::response;
+
+    std::shared_ptr<detail::pipeline_core<Codec>> core;
+
+    pipeline_client(rio::context &ctx, rio::Tcp_socket sock, Codec codec = {}, pipeline_options opts = {})
+        : core(std::make_shared<detail::pipeline_core<Codec>>(ctx, std::move(sock), std::move(codec), opts)) {}
+
+    pipeline_client(pipeline_client &&) noexcept = default;
+    pipeline_client &operator=(pipeline_client &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            core = std::move(other.core);
+        }
+        return *this;
+    }
+    pipeline_client(const pipeline_client &) = delete;
+    pipeline_client &operator=(const pipeline_client &) = delete;
+    ~pipeline_client() { close(); }
+
+    // Shuts the connection down, outstanding calls fail with operation_canceled. Calls made after it fail too.
+    // Without it a read stays armed for calls that timed out, and holds the connection open while the peer is silent.
+    void close()
+    {
+        if (core)
+            core->close();
+    }
+
+    auto call(const request &rq)
+    {
+        return rio::Future(core->submit(rq), [](typename detail::pipeline_core<Codec>::slot_ptr &s) -> fut::res<response> {
+            if (!s->done)
+                return fut::res<response>::pending();
+            if (s->value)
+                return fut::res<response>::ready(std::move(*std::exchange(s->value, std::nullopt)));
+            return fut::res<response>::error(s->err);
+        });
+    }
+
+    // Fails with timed_out after `deadline`. The request stays on the wire, its late response is dropped.
+    template <typename Rep, typename Period>
+    auto call(const request &rq, std::chrono::duration<Rep, Period> deadline)
+    {
+        return rio::fut::stop_after(*core->ctx, call(rq), deadline);
+    }
+
+    [[nodiscard]] auto outstanding() const -> std::size_t { return core->outstanding(); }
+    [[nodiscard]] auto broken() const -> std::error_code { return core->broken; }
+    [[nodiscard]] auto stats() const -> const pipeline_stats & { return core->stats; }
+};
+
+}  // namespace rio::fut
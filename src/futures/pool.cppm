@@ -0,0 +1,231 @@
+module;
+
+#include <sys/socket.h>
+#include <cerrno>
+
+export module rio:fut.pool;
+
+import std;
+import :context;
+import :socket;
+import :asio;
+import :futures;
+
+namespace rio::fut {
+
+export struct pool_options
+{
+    std::size_t max_idle_per_host = 16;
+    // Dials in flight per address. Callers past it wait for the next connection to come up or be released.
+    std::size_t max_dials_per_host = 4;
+    std::chrono::milliseconds idle_timeout{30'000};
+    std::chrono::milliseconds connect_timeout{3'000};
+    s_opt options = s_opt::client;
+};
+
+export struct pool_stats
+{
+    std::uint64_t hits = 0;       // Served from the idle list
+    std::uint64_t dials = 0;
+    std::uint64_t coalesced = 0;  // Waited on dials already in flight instead of dialing
+    std::uint64_t stale = 0;      // Idle connections dropped: expired, closed by the peer or holding stray bytes
+    std::uint64_t failed = 0;     // Dials that failed
+};
+
+namespace detail {
+
+struct pool_slot
+{
+    std::optional<rio::Tcp_socket> sock;
+    std::error_code err;
+    bool done = false;
+};
+
+struct pool_host
+{
+    struct idle_conn
+    {
+        rio::Tcp_socket sock;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    rio::address addr;
+    std::vector<idle_conn> idle;  // Most recently released at the back
+    std::deque<std::weak_ptr<pool_slot>> waiters;
+    std::size_t dialing = 0;
+};
+
+// Peer closed (recv = 0), sent something unsolicited (> 0) or failed: not reusable. Only EAGAIN is healthy.
+inline auto healthy(const rio::Tcp_socket &s) -> bool
+{
+    char b;
+    return ::recv(s.fd, &b, 1, MSG_PEEK | MSG_DONTWAIT) == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+// Shared with the dial callbacks, so the pool may go away while dials are in flight.
+struct pool_core : std::enable_shared_from_this<pool_core>
+{
+    rio::context *ctx;
+    pool_options opts;
+    std::unordered_map<std::string, pool_host> hosts;
+    pool_stats stats;
+
+    static auto key(const rio::address &a) -> std::string { return {reinterpret_cast<const char *>(a.data()), a.size()}; }
+
+    auto host(const rio::address &a) -> pool_host &
+    {
+        auto [it, fresh] = hosts.try_emplace(key(a));
+        if (fresh)
+            it->second.addr = a;
+        return it->second;
+    }
+
+    auto take_idle(pool_host &h) -> std::optional<rio::Tcp_socket>
+    {
+        const auto now = std::chrono::steady_clock::now();
+        while (!h.idle.empty())
+        {
+            auto c = std::move(h.idle.back());
+            h.idle.pop_back();
+            if (now - c.since < opts.idle_timeout && healthy(c.sock))
+                return std::move(c.sock);
+            ++stats.stale;
+        }
+        return std::nullopt;
+    }
+
+    // First waiter whose future is still around, nullptr when none.
+    static auto next_waiter(pool_host &h) -> std::shared_ptr<pool_slot>
+    {
+        while (!h.waiters.empty())
+        {
+            auto w = h.waiters.front().lock();
+            h.waiters.pop_front();
+            if (w && !w->done)
+                return w;
+        }
+        return nullptr;
+    }
+
+    // True when a waiter got the connection.
+    auto deliver(pool_host &h, rio::Tcp_socket sock) -> bool
+    {
+        if (auto w = next_waiter(h))
+        {
+            w->sock.emplace(std::move(sock));
+            w->done = true;
+            return true;
+        }
+        if (h.idle.size() < opts.max_idle_per_host)
+            h.idle.push_back({std::move(sock), std::chrono::steady_clock::now()});
+        return false;
+    }
+
+    // Keeps one dial going per waiter, up to max_dials_per_host.
+    void pump(pool_host &h)
+    {
+        std::erase_if(h.waiters, [](const auto &w) { return w.expired(); });
+        while (h.dialing < std::min(h.waiters.size(), opts.max_dials_per_host))
+            dial(h);
+    }
+
+    void dial(pool_host &h)
+    {
+        ++h.dialing;
+        ++stats.dials;
+        auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(opts.connect_timeout);
+        rio::as::connect(*ctx, h.addr, opts.options, timeout,
+            [self = shared_from_this(), k = key(h.addr)](rio::context &, rio::result<rio::Tcp_socket> res, pool_core *) {
+                auto &host = self->hosts[k];
+                --host.dialing;
+                if (res)
+                    self->deliver(host, std::move(*res));
+                else
+                {
+                    ++self->stats.failed;
+                    if (auto w = next_waiter(host))
+                    {
+                        w->err = res.error().code;
+                        w->done = true;
+                    }
+                }
+                self->pump(host);
+            },
+            this);
+    }
+};
+
+}  // namespace detail
+
+// Per-context pool of outbound connections keyed by address. acquire() hands out a healthy idle connection
+// or waits for one: concurrent callers for the same address share at most max_dials_per_host dials and take
+// connections in arrival order, whether freshly dialed or released by someone else. Single threaded, like
+// everything bound to a context.
+export struct connection_pool
+{
+    std::shared_ptr<detail::pool_core> core;
+
+    explicit connection_pool(rio::context &ctx, pool_options opts = {}) : core(std::make_shared<detail::pool_core>())
+    {
+        core->ctx = &ctx;
+        core->opts = std::move(opts);
+    }
+
+    auto acquire(const rio::address &addr)
+    {
+        auto slot = std::make_shared<detail::pool_slot>();
+        auto &h = core->host(addr);
+
+        if (auto sock = core->take_idle(h))
+        {
+            ++core->stats.hits;
+            slot->sock = std::move(sock);
+            slot->done = true;
+        }
+        else
+        {
+            if (h.dialing >= core->opts.max_dials_per_host)
+                ++core->stats.coalesced;
+            h.waiters.push_back(slot);
+            core->pump(h);
+        }
+
+        return rio::Future(std::move(slot), [](std::shared_ptr<detail::pool_slot> &s) -> fut::res<rio::Tcp_socket> {
+            if (!s->done)
+                return fut::res<rio::Tcp_socket>::pending();
+            if (s->sock)
+                return fut::res<rio::Tcp_socket>::ready(std::move(*std::exchange(s->sock, std::nullopt)));
+            return fut::res<rio::Tcp_socket>::error(s->err);
+        });
+    }
+
+    // Gives a connection back for reuse. Only release it between requests, with nothing left to read or write.
+    void release(const rio::address &addr, rio::Tcp_socket sock)
+    {
+        // No completion comes with a release: wake the loop, or a waiter could sit until its next tick.
+        auto &h = core->host(addr);
+        if (core->deliver(h, std::move(sock)))
+            core->ctx->wake();
+    }
+
+    // Drops expired idle connections, returns how many. Cheap enough to call from a periodic task.
+    auto prune() -> std::size_t
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::size_t n = 0;
+        for (auto &[_, h] : core->hosts)
+            n += std::erase_if(h.idle, [&](const auto &c) { return now - c.since >= core->opts.idle_timeout; });
+        core->stats.stale += n;
+        return n;
+    }
+
+    [[nodiscard]] auto idle(const rio::address &addr) const -> std::size_t
+    {
+        auto it = core->hosts.find(detail::pool_core::key(addr));
+        return it == core->hosts.end() ? 0 : it->second.idle.size();
+    }
+
+    [[nodiscard]] auto stats() const -> const pool_stats & { return core->stats; }
+};
+
+}  // namespace rio::fut
@@ -0,0 +1,287 @@
+module;
+export module rio:fut.sync;
+
+import std;
+import :context;
+import :futures;
+
+namespace rio::fut {
+
+namespace detail {
+
+// Wait-queue entry living inside the waiting future itself, so waiting allocates nothing.
+// Futures move (into a task, a then() chain...), a queued node re-links itself from its new address.
+template <typename Owner>
+struct waiter
+{
+    Owner *owner = nullptr;
+    std::size_t want = 1;
+    waiter *prev = nullptr;
+    waiter *next = nullptr;
+    bool queued = false;
+    bool granted = false;  // Owner handed over its share, the future hasn't returned it yet
+
+    waiter(Owner *o, std::size_t n) : owner(o), want(n) {}
+
+    waiter(waiter &&other) noexcept { take(other); }
+
+    waiter &operator=(waiter &&other) noexcept
+    {
+        if (this != &other)
+        {
+            leave();
+            take(other);
+        }
+        return *this;
+    }
+
+    waiter(const waiter &) = delete;
+    waiter &operator=(const waiter &) = delete;
+
+    ~waiter() { leave(); }
+
+private:
+    void take(waiter &other)
+    {
+        owner = other.owner;
+        want = other.want;
+        prev = other.prev;
+        next = other.next;
+        queued = std::exchange(other.queued, false);
+        granted = std::exchange(other.granted, false);
+        if (queued)
+            owner->waiters.replace(&other, this);
+    }
+
+    // Dropped while queued: leave the line. Dropped after being granted: pass the share on.
+    void leave()
+    {
+        if (queued)
+            owner->waiters.remove(this);
+        if (std::exchange(granted, false))
+            owner->give_back(*this);
+    }
+};
+
+template <typename Owner>
+struct waiter_queue
+{
+    using node = waiter<Owner>;
+
+    node *head = nullptr;
+    node *tail = nullptr;
+    std::size_t count = 0;
+
+    [[nodiscard]] auto empty() const -> bool { return head == nullptr; }
+    [[nodiscard]] auto front() const -> node * { return head; }
+
+    void push_back(node *n)
+    {
+        n->prev = tail;
+        n->next = nullptr;
+        (tail ? tail->next : head) = n;
+        tail = n;
+        n->queued = true;
+        ++count;
+    }
+
+    auto pop_front() -> node *
+    {
+        node *n = head;
+        remove(n);
+        return n;
+    }
+
+    void remove(node *n)
+    {
+        (n->prev ? n->prev->next : head) = n->next;
+        (n->next ? n->next->prev : tail) = n->prev;
+        n->prev = n->next = nullptr;
+        n->queued = false;
+        --count;
+    }
+
+    // `to` already copied prev/next from `from`, point the neighbours at it.
+    void replace(node *from, node *to)
+    {
+        (to->prev ? to->prev->next : head) = to;
+        (to->next ? to->next->prev : tail) = to;
+        from->prev = from->next = nullptr;
+    }
+};
+
+}  // namespace detail
+
+// Counting semaphore for futures on one context (not thread safe). Waiters are served strictly FIFO:
+// a large request at the head is not overtaken by smaller ones behind it.
+// A release wakes the context, so the granted future is re-polled on the next loop instead of next tick.
+export struct semaphore
+{
+    // Held permits, given back when dropped.
+    struct permit
+    {
+        semaphore *sem = nullptr;
+        std::size_t n = 0;
+
+        permit(semaphore *s, std::size_t count) : sem(s), n(count) {}
+        permit(permit &&other) noexcept : sem(std::exchange(other.sem, nullptr)), n(other.n) {}
+        permit &operator=(permit &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                sem = std::exchange(other.sem, nullptr);
+                n = other.n;
+            }
+            return *this;
+        }
+        permit(const permit &) = delete;
+        permit &operator=(const permit &) = delete;
+        ~permit() { release(); }
+
+        void release()
+        {
+            if (sem)
+                std::exchange(sem, nullptr)->release(n);
+        }
+    };
+
+    semaphore(rio::context &c, std::size_t permits) : ctx(&c), available_(permits) {}
+
+    // Waiters point at it.
+    semaphore(const semaphore &) = delete;
+    semaphore &operator=(const semaphore &) = delete;
+
+    auto try_acquire(std::size_t n = 1) -> std::optional<permit>
+    {
+        if (!waiters.empty() || available_ < n)
+            return std::nullopt;
+        available_ -= n;
+        return permit{this, n};
+    }
+
+    // Resolves to a permit for n units. The semaphore must outlive the future and the permit.
+    auto acquire(std::size_t n = 1)
+    {
+        return rio::Future(detail::waiter<semaphore>{this, n}, [](detail::waiter<semaphore> &w) -> fut::res<permit> {
+            auto *s = w.owner;
+            if (std::exchange(w.granted, false))
+                return fut::res<permit>::ready(permit{s, w.want});
+
+            if (!w.queued)
+            {
+                if (auto p = s->try_acquire(w.want))
+                    return fut::res<permit>::ready(std::move(*p));
+                s->waiters.push_back(&w);
+            }
+            return fut::res<permit>::pending();
+        });
+    }
+
+    void release(std::size_t n = 1)
+    {
+        available_ += n;
+
+        bool woke = false;
+        while (!waiters.empty() && waiters.front()->want <= available_)
+        {
+            auto *w = waiters.pop_front();
+            available_ -= w->want;
+            w->granted = true;
+            woke = true;
+        }
+        if (woke)
+            ctx->wake();
+    }
+
+    [[nodiscard]] auto available() const -> std::size_t { return available_; }
+    [[nodiscard]] auto waiting() const -> std::size_t { return waiters.count; }
+
+private:
+    friend struct detail::waiter<semaphore>;
+
+    void give_back(detail::waiter<semaphore> &w) { release(w.want); }
+
+    rio::context *ctx;
+    std::size_t available_;
+    detail::waiter_queue<semaphore> waiters{};
+};
+
+// Async mutex: lock() resolves to a guard, the next waiter in line gets it when the guard drops.
+export struct mutex
+{
+    using guard = semaphore::permit;
+
+    explicit mutex(rio::context &ctx) : sem(ctx, 1) {}
+
+    auto lock() { return sem.acquire(1); }
+    auto try_lock() -> std::optional<guard> { return sem.try_acquire(1); }
+
+    [[nodiscard]] auto locked() const -> bool { return sem.available() == 0; }
+    [[nodiscard]] auto waiting() const -> std::size_t { return sem.waiting(); }
+
+private:
+    semaphore sem;
+};
+
+// Wakeup signal between futures on one context.
+// notify_one() with nobody waiting is remembered, the next wait() completes at once (one stored permit at most).
+export struct notify
+{
+    explicit notify(rio::context &c) : ctx(&c) {}
+
+    notify(const notify &) = delete;
+    notify &operator=(const notify &) = delete;
+
+    // The notify must outlive the future.
+    auto wait()
+    {
+        return rio::Future(detail::waiter<notify>{this, 1}, [](detail::waiter<notify> &w) -> fut::res<void> {
+            auto *n = w.owner;
+            if (std::exchange(w.granted, false))
+                return fut::res<void>::ready();
+
+            if (!w.queued)
+            {
+                if (std::exchange(n->stored, false))
+                    return fut::res<void>::ready();
+                n->waiters.push_back(&w);
+            }
+            return fut::res<void>::pending();
+        });
+    }
+
+    void notify_one()
+    {
+        if (waiters.empty())
+        {
+            stored = true;
+            return;
+        }
+        waiters.pop_front()->granted = true;
+        ctx->wake();
+    }
+
+    // Wakes everyone waiting right now, stores nothing for later waiters.
+    void notify_all()
+    {
+        if (waiters.empty())
+            return;
+        while (!waiters.empty()) waiters.pop_front()->granted = true;
+        ctx->wake();
+    }
+
+    [[nodiscard]] auto waiting() const -> std::size_t { return waiters.count; }
+
+private:
+    friend struct detail::waiter<notify>;
+
+    // A woken future dropped before it saw the wakeup hands it to the next one in line.
+    void give_back(detail::waiter<notify> &) { notify_one(); }
+
+    rio::context *ctx;
+    bool stored = false;
+    detail::waiter_queue<notify> waiters{};
+};
+
+}  // namespace rio::fut
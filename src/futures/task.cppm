@@ -0,0 +1,54 @@
+module;
+export module rio:fut.task;
+
+import std;
+import :futures;
+
+namespace rio::fut {
+
+// Type-erased, owning handle to any Pollable whose result is dropped.
+// Lets executors keep heterogeneous futures (lambda types differ per call site) in one container.
+export struct task
+{
+    struct base
+    {
+        virtual ~base() = default;
+        virtual auto poll() -> fut::status = 0;
+        virtual auto error() const -> std::error_code = 0;
+    };
+
+    template <Pollable F>
+    struct impl final : base
+    {
+        F fut;
+        std::error_code err{};
+
+        explicit impl(F f) : fut(std::move(f)) {}
+
+        auto poll() -> fut::status override
+        {
+            auto r = rio::poll(fut);
+            if (r.state == fut::status::error)
+                err = r.err;
+            return r.state;
+        }
+        auto error() const -> std::error_code override { return err; }
+    };
+
+    std::unique_ptr<base> ptr;
+
+    task() = default;
+
+    template <Pollable F>
+    requires(!std::same_as<std::decay_t<F>, task>)
+    task(F &&f) : ptr(std::make_unique<impl<std::decay_t<F>>>(std::forward<F>(f))) {}
+
+    task(task &&) = default;
+    task &operator=(task &&) = default;
+
+    auto poll() -> fut::status { return ptr->poll(); }
+    [[nodiscard]] auto error() const -> std::error_code { return ptr->error(); }
+    explicit operator bool() const { return static_cast<bool>(ptr); }
+};
+
+}  // namespace rio::fut
@@ -0,0 +1,414 @@
+module;
+
+#include <sys/uio.h>
+
+export module rio:http.parser;
+
+import std;
+import :utils;
+import :utils.simd;
+
+namespace rio::http {
+
+export struct limits
+{
+    std::size_t max_headers = 64;
+    std::size_t max_body = 8 << 20;
+};
+
+export struct header
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+// Views into the receive buffer, valid until the connection reads again (after the response was written).
+export struct request
+{
+    static constexpr std::size_t header_capacity = 64;
+
+    std::string_view method;
+    std::string_view target;
+    int minor_version = 1;  // HTTP/1.<minor>
+    std::array<header, header_capacity> headers{};
+    std::size_t header_count = 0;
+
+    std::size_t content_length = 0;
+    bool chunked = false;
+    bool keep_alive = true;
+    std::string_view body;
+
+    // First header named `name`, case-insensitive.
+    [[nodiscard]] auto get(std::string_view name) const -> std::optional<std::string_view>;
+    [[nodiscard]] auto fields() const -> std::span<const header> { return {headers.data(), header_count}; }
+};
+
+auto iequals(std::string_view a, std::string_view b) -> bool
+{
+    return a.size() == b.size() && std::ranges::equal(a, b, [](char x, char y) { return (x | 0x20) == (y | 0x20); });
+}
+
+// Calls fn(item) for every non-empty item of a comma separated token list (Connection, Transfer-Encoding).
+template <typename Fn>
+void for_each_token(std::string_view list, Fn &&fn)
+{
+    while (!list.empty())
+    {
+        auto comma = list.find(',');
+        auto item = list.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (!item.empty())
+            fn(item);
+        if (comma == std::string_view::npos)
+            break;
+        list.remove_prefix(comma + 1);
+    }
+}
+
+auto has_token(std::string_view list, std::string_view token) -> bool
+{
+    bool found = false;
+    for_each_token(list, [&](std::string_view item) { found = found || iequals(item, token); });
+    return found;
+}
+
+auto request::get(std::string_view name) const -> std::optional<std::string_view>
+{
+    for (const auto &h : fields())
+        if (iequals(h.name, name))
+            return h.value;
+    return std::nullopt;
+}
+
+auto bad(std::string_view what) -> rio::Err { return Err::app(std::errc::bad_message, std::string(what)); }
+
+// RFC 9110 5.6.2 token characters, what a field name is made of.
+constexpr auto tchars = [] {
+    std::array<bool, 256> t{};
+    for (unsigned char c = '0'; c <= '9'; ++c) t[c] = true;
+    for (unsigned char c = 'a'; c <= 'z'; ++c) t[c] = t[c - 0x20] = true;
+    for (unsigned char c : std::string_view("!#$%&'*+-.^_`|~")) t[c] = true;
+    return t;
+}();
+
+auto is_token(std::string_view s) -> bool
+{
+    return !s.empty() && std::ranges::all_of(s, [](char c) { return tchars[static_cast<unsigned char>(c)]; });
+}
+
+auto trim(std::string_view s) -> std::string_view
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// Parses the request line and headers at the front of `in`. Returns the head's length including the blank line,
+// 0 when it is not complete yet. The line and ':' scans are rio::simd::find.
+// Errors: bad_message (answer 400), message_size (431), file_too_large (413), function_not_supported for a
+// transfer coding other than chunked (501).
+export auto parse_head(std::string_view in, request &r, const limits &lim = {}) -> rio::result<std::size_t>
+{
+    const char *p = in.data();
+    const char *end = p + in.size();
+
+    auto next_line = [&](std::string_view &line) -> bool {
+        const char *nl = rio::simd::find(p, end, '\n');
+        if (nl == end)
+            return false;
+        line = std::string_view(p, static_cast<std::size_t>(nl - p));
+        if (line.ends_with('\r'))
+            line.remove_suffix(1);
+        p = nl + 1;
+        return true;
+    };
+    // A CR anywhere but right before the LF is how some parsers get split differently from others (RFC 9112 2.2).
+    auto bare_cr = [](std::string_view line) { return rio::simd::find(line, '\r') != std::string_view::npos; };
+
+    // Request line: METHOD SP target SP HTTP/1.x. Stray empty lines before it are allowed (RFC 9112 2.2).
+    std::string_view line;
+    do
+        if (!next_line(line))
+            return 0;
+    while (line.empty());
+    if (bare_cr(line))
+        return std::unexpected(bad("Bare CR in request line"));
+
+    auto sp1 = line.find(' ');
+    auto sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp2 == std::string_view::npos)
+        return std::unexpected(bad("Malformed request line"));
+
+    r.method = line.substr(0, sp1);
+    r.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    auto version = line.substr(sp2 + 1);
+    if (r.method.empty() || r.target.empty() || version.size() != 8 || !version.starts_with("HTTP/1.") || version[7] < '0' || version[7] > '9')
+        return std::unexpected(bad("Malformed request line"));
+    r.minor_version = version[7] - '0';
+
+    r.header_count = 0;
+    const auto max_headers = std::min(lim.max_headers, request::header_capacity);
+    while (true)
+    {
+        if (!next_line(line))
+            return 0;
+        if (line.empty())
+            break;
+        if (line.front() == ' ' || line.front() == '\t')
+            return std::unexpected(bad("Obsolete header line folding"));
+        if (r.header_count == max_headers)
+            return std::unexpected(Err::app(std::errc::message_size, "Too many headers"));
+
+        if (bare_cr(line))
+            return std::unexpected(bad("Bare CR in header"));
+
+        // The name is a token, so whitespace before the colon (RFC 9112 5.1) is rejected with the rest.
+        auto colon = rio::simd::find(line, ':');
+        if (colon == std::string_view::npos || !is_token(line.substr(0, colon)))
+            return std::unexpected(bad("Malformed header"));
+        r.headers[r.header_count++] = {.name = line.substr(0, colon), .value = trim(line.substr(colon + 1))};
+    }
+
+    // Framing and persistence.
+    r.content_length = 0;
+    r.chunked = false;
+    r.body = {};
+    bool have_length = false;
+    // Transfer codings over every TE field in order, how many were "chunked" and the position of the last one.
+    std::size_t codings = 0, chunked = 0, chunked_at = 0;
+    bool have_te = false;
+    std::optional<std::string_view> connection;
+    for (const auto &h : r.fields())
+    {
+        if (iequals(h.name, "content-length"))
+        {
+            std::size_t n = 0;
+            auto [ptr, ec] = std::from_chars(h.value.data(), h.value.data() + h.value.size(), n);
+            if (ec != std::errc{} || ptr != h.value.data() + h.value.size() || (have_length && n != r.content_length))
+                return std::unexpected(bad("Invalid Content-Length"));
+            r.content_length = n;
+            have_length = true;
+        }
+        else if (iequals(h.name, "transfer-encoding"))
+        {
+            have_te = true;
+            for_each_token(h.value, [&](std::string_view coding) {
+                ++codings;
+                if (iequals(coding, "chunked"))
+                    ++chunked, chunked_at = codings;
+            });
+        }
+        else if (iequals(h.name, "connection"))
+            connection = h.value;
+    }
+
+    // RFC 9112 6.3: with Transfer-Encoding present, chunked must be the final coding (and appear once), else the
+    // body length is unknowable and the rest of the stream could be read as the next request. Only chunked is decoded.
+    if (have_te)
+    {
+        if (chunked != 1 || chunked_at != codings)
+            return std::unexpected(bad("Transfer-Encoding must end in a single chunked"));
+        if (codings > 1)
+            return std::unexpected(Err::app(std::errc::function_not_supported, "Transfer coding other than chunked"));
+    }
+    r.chunked = have_te;
+
+    // Both framings at once is how requests get smuggled past proxies, refuse it.
+    if (r.chunked && have_length)
+        return std::unexpected(bad("Both Content-Length and chunked Transfer-Encoding"));
+    if (r.content_length > lim.max_body)
+        return std::unexpected(Err::app(std::errc::file_too_large, "Request body too large"));
+
+    r.keep_alive = r.minor_version >= 1 ? !(connection && has_token(*connection, "close")) : (connection && has_token(*connection, "keep-alive"));
+    return static_cast<std::size_t>(p - in.data());
+}
+
+// Decodes a whole chunked body from the front of `in` into `out`. Returns the bytes consumed (trailers included),
+// 0 when the body is not complete yet; `out` is only final on success.
+export auto decode_chunked(std::string_view in, std::string &out, const limits &lim = {}) -> rio::result<std::size_t>
+{
+    out.clear();
+    std::size_t at = 0;
+    while (true)
+    {
+        auto nl = rio::simd::find(in.substr(at), '\n');
+        if (nl == std::string_view::npos)
+            return 0;
+
+        auto size_line = in.substr(at, nl);
+        size_line = size_line.substr(0, size_line.find(';'));  // Chunk extensions are ignored
+        size_line = trim(size_line);
+
+        std::size_t n = 0;
+        auto [ptr, ec] = std::from_chars(size_line.data(), size_line.data() + size_line.size(), n, 16);
+        if (ec != std::errc{} || ptr != size_line.data() + size_line.size())
+            return std::unexpected(bad("Invalid chunk size"));
+        at += nl + 1;
+
+        if (n == 0)
+        {
+            // Trailer fields up to the blank line, skipped.
+            while (true)
+            {
+                auto t = rio::simd::find(in.substr(at), '\n');
+                if (t == std::string_view::npos)
+                    return 0;
+                auto trailer = in.substr(at, t);
+                at += t + 1;
+                if (trailer.empty() || trailer == "\r")
+                    return at;
+            }
+        }
+
+        // Checked before any arithmetic on n, a size like ffffffffffffffff would wrap.
+        if (n > lim.max_body - out.size())
+            return std::unexpected(Err::app(std::errc::file_too_large, "Request body too large"));
+        if (in.size() - at < n + 2)
+            return 0;
+        if (in.substr(at + n, 2) != "\r\n")
+            return std::unexpected(bad("Chunk not followed by CRLF"));
+        out.append(in.substr(at, n));
+        at += n + 2;
+    }
+}
+
+export auto reason(int status) -> std::string_view
+{
+    switch (status)
+    {
+    case 100: return "Continue";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 413: return "Content Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
+
+// Response built for a vectored write: the head is formatted once, body pieces are either owned by the response
+// or borrowed views that must stay alive until it is written (the request's views qualify).
+// chunk() switches to chunked transfer coding on HTTP/1.1, HTTP/1.0 peers get the same pieces with a Content-Length.
+// Answers that carry no content (HEAD, 1xx, 204, 304) go out without the body, whatever the handler added.
+export struct response
+{
+    int status = 200;
+
+    void header(std::string_view name, std::string_view value) { std::format_to(std::back_inserter(fields), "{}: {}\r\n", name, value); }
+
+    void body(std::string b) { add(std::move(b)); }
+    void body_view(std::string_view v) { pieces.push_back({.owned = npos, .view = v}); }
+
+    void chunk(std::string b)
+    {
+        chunked = true;
+        add(std::move(b));
+    }
+    void chunk_view(std::string_view v)
+    {
+        chunked = true;
+        body_view(v);
+    }
+
+    // Formats the status line and the framing headers for a request with `method`. Called by the engine once the
+    // handler returned. RFC 9110: 1xx and 204 carry no framing headers, 304 none either (they would describe
+    // the unsent representation), HEAD gets the ones a GET would but no body or chunk bytes.
+    void finish(std::string_view method, int minor_version, bool keep_alive)
+    {
+        const bool bodyless_status = (status >= 100 && status < 200) || status == 204 || status == 304;
+        send_body = !bodyless_status && method != "HEAD";
+        use_chunks = chunked && minor_version >= 1;
+        head.clear();
+        std::format_to(std::back_inserter(head), "HTTP/1.{} {} {}\r\n", minor_version >= 1 ? 1 : 0, status, reason(status));
+        head += fields;
+        if (use_chunks && !bodyless_status)
+            head += "Transfer-Encoding: chunked\r\n";
+        else if (!bodyless_status)
+        {
+            std::size_t len = 0;
+            for (const auto &p : pieces) len += view_of(p).size();
+            std::format_to(std::back_inserter(head), "Content-Length: {}\r\n", len);
+        }
+        if (!keep_alive)
+            head += "Connection: close\r\n";
+        else if (minor_version == 0)
+            head += "Connection: keep-alive\r\n";
+        head += "\r\n";
+    }
+
+    // Appends the wire form to `iov`. The response must not change or move until the write is done.
+    void append_iov(std::vector<iovec> &iov)
+    {
+        auto push = [&](std::string_view v) {
+            if (!v.empty())
+                iov.push_back({.iov_base = const_cast<char *>(v.data()), .iov_len = v.size()});
+        };
+
+        push(head);
+        if (!send_body)
+            return;
+        if (!use_chunks)
+        {
+            for (const auto &p : pieces) push(view_of(p));
+            return;
+        }
+
+        chunk_lines.clear();
+        chunk_lines.reserve(pieces.size());
+        for (const auto &p : pieces)
+        {
+            auto v = view_of(p);
+            if (v.empty())
+                continue;  // A zero-size chunk would end the body
+            chunk_lines.push_back(std::format("{:x}\r\n", v.size()));
+            push(chunk_lines.back());
+            push(v);
+            push("\r\n");
+        }
+        push("0\r\n\r\n");
+    }
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    struct piece
+    {
+        std::size_t owned;  // Index into `owned_bodies`, npos for a borrowed view
+        std::string_view view;
+    };
+
+    void add(std::string b)
+    {
+        owned_bodies.push_back(std::move(b));
+        pieces.push_back({.owned = owned_bodies.size() - 1, .view = {}});
+    }
+
+    // Owned pieces are resolved late: strings move (and SSO buffers with them) while the response is built.
+    [[nodiscard]] auto view_of(const piece &p) const -> std::string_view { return p.owned == npos ? p.view : std::string_view(owned_bodies[p.owned]); }
+
+    std::string fields;
+    std::string head;
+    std::vector<std::string> owned_bodies;
+    std::vector<piece> pieces;
+    std::vector<std::string> chunk_lines;
+    bool chunked = false;
+    bool use_chunks = false;
+    bool send_body = true;
+};
+
+}  // namespace rio::http
@@ -0,0 +1,368 @@
+module;
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <liburing.h>
+#include <cerrno>
+
+export module rio:http.server;
+
+import std;
+import :utils;
+import :context;
+import :socket;
+import :asio;
+import :fut.framing;
+import :http.parser;
+
+namespace rio::http {
+
+export struct server_options
+{
+    std::size_t buffer = 64 * 1024;  // Per connection receive ring, also the largest request head (and inline body)
+    std::chrono::milliseconds idle_timeout{60'000};
+    std::chrono::milliseconds tick{100};  // Timer wheel resolution
+    std::chrono::milliseconds accept_backoff{100};  // Pause before re-arming accept after EMFILE/ENFILE/ENOBUFS/ENOMEM
+    limits parse{};
+};
+
+export struct server_stats
+{
+    std::uint64_t accepted = 0;
+    std::uint64_t requests = 0;
+    std::uint64_t writes = 0;  // requests / writes is the pipelining factor
+    std::uint64_t timeouts = 0;
+    std::uint64_t bad_requests = 0;
+    std::uint64_t accept_errors = 0;
+    std::uint64_t live = 0;
+};
+
+export template <typename Handler>
+concept handler_C = std::invocable<Handler &, const request &, response &>;
+
+// HTTP/1.1 server engine on one context: keep-alive and pipelining, chunked request bodies, vectored responses.
+// Each connection reads into a frame_buffer, parses every complete request it holds, runs the handler inline
+// for each (requests are views into that buffer) and writes all their responses with one writev. It reads
+// again only once that write is done, so request views stay valid for borrowed response bodies.
+// Idle connections are shut down through a timer wheel advanced from a ring timeout.
+// The server must stay at its address while its context runs; one per context (or per runtime worker).
+export template <handler_C Handler>
+struct server
+{
+    server(rio::context &ctx, rio::Tcp_socket listener, Handler handler, server_options opts = {})
+        : ctx(ctx), listener(std::move(listener)), handler(std::move(handler)), opts(opts), wheel(opts.tick) {}
+
+    server(const server &) = delete;
+    server &operator=(const server &) = delete;
+
+    // Arms the accept and the idle ticker.
+    void start()
+    {
+        stopping = false;
+        arm_accept();
+        ticker.srv = this;
+        ticker.header.call = &ticker_req::on_complete;
+        arm_tick();
+    }
+
+    // Stops accepting and ticking, live connections finish their current exchange and close.
+    void stop()
+    {
+        stopping = true;
+        ::shutdown(listener.fd, SHUT_RDWR);
+        for (auto &[_, c] : conns) ::shutdown(c->sock.fd, SHUT_RD);
+    }
+
+    [[nodiscard]] auto stats() const -> const server_stats & { return st; }
+
+private:
+    struct connection
+    {
+        server *srv;
+        std::uint64_t id;
+        rio::Tcp_socket sock;
+        fut::frame_buffer in;
+
+        request req;
+        std::string chunked_body;  // Decoded body of the current chunked request
+        std::deque<response> out;  // Stable addresses, the writev points into them
+        std::vector<iovec> iov;
+        std::size_t iov_at = 0;
+
+        std::size_t consumed = 0;  // Bytes of `in` used by the requests being answered, released after the write
+        std::chrono::steady_clock::time_point last_active;
+        bool busy = false;  // A read or write is in flight
+        bool closing = false;
+    };
+
+    struct ticker_req
+    {
+        rio::internals::uring_request_header header;
+        server *srv = nullptr;
+        __kernel_timespec ts{};
+
+        static void on_complete(rio::internals::uring_request_header *ptr, int)
+        {
+            auto *self = reinterpret_cast<ticker_req *>(ptr);
+            self->srv->wheel.advance();
+            self->srv->arm_tick();
+        }
+    };
+
+    void arm_tick()
+    {
+        if (stopping)
+            return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(opts.tick).count();
+        ticker.ts = {.tv_sec = ns / 1'000'000'000, .tv_nsec = ns % 1'000'000'000};
+        auto *sqe = ctx.sqe();
+        io_uring_prep_timeout(sqe, &ticker.ts, 0, 0);
+        io_uring_sqe_set_data(sqe, &ticker.header);
+        ctx.submit();
+    }
+
+    void arm_accept()
+    {
+        if (stopping)
+            return;
+        rio::as::accept(ctx, listener, [](rio::context &, rio::result<rio::as::accept_result> res, server *self) {
+            if (res)
+            {
+                self->adopt(std::move(res->client));
+                return self->arm_accept();
+            }
+
+            ++self->st.accept_errors;
+            const auto ec = res.error().code;
+            // Out of fds or memory: re-arming at once would spin on the ring, retry from the timer wheel.
+            if (ec == std::errc::too_many_files_open || ec == std::errc::too_many_files_open_in_system ||
+                ec == std::errc::no_buffer_space || ec == std::errc::not_enough_memory)
+            {
+                self->wheel.schedule_after(self->opts.accept_backoff, [self] { self->arm_accept(); });
+                return;
+            }
+            // The peer gave up before we took it, or a signal: just accept the next one.
+            if (ec == std::errc::connection_aborted || ec == std::errc::interrupted || ec == std::errc::resource_unavailable_try_again)
+                return self->arm_accept();
+            // Anything else (listener shut down or cancelled, bad fd) will not get better, stop accepting.
+        }, this);
+    }
+
+    void adopt(rio::Tcp_socket sock)
+    {
+        auto buf = fut::frame_buffer::create(opts.buffer);
+        if (!buf)
+            return;
+
+        const auto id = next_id++;
+        auto c = std::make_unique<connection>();
+        c->srv = this;
+        c->id = id;
+        c->sock = std::move(sock);
+        c->in = std::move(*buf);
+        c->last_active = std::chrono::steady_clock::now();
+
+        auto *raw = c.get();
+        conns.emplace(id, std::move(c));
+        ++st.accepted;
+        st.live = conns.size();
+
+        watch_idle(id, raw->last_active + opts.idle_timeout);
+        arm_read(*raw);
+    }
+
+    // Lazy idle check: activity only moves last_active, the timer re-schedules itself until a full timeout passed.
+    void watch_idle(std::uint64_t id, std::chrono::steady_clock::time_point when)
+    {
+        wheel.schedule(when, [this, id] {
+            auto it = conns.find(id);
+            if (it == conns.end())
+                return;
+            auto &c = *it->second;
+            if (c.closing)
+                return;
+            auto due = c.last_active + opts.idle_timeout;
+            if (std::chrono::steady_clock::now() < due)
+                return watch_idle(id, due);
+            ++st.timeouts;
+            c.closing = true;
+            // The pending read completes with 0, which closes the connection from its own callback.
+            ::shutdown(c.sock.fd, SHUT_RDWR);
+        });
+    }
+
+    void arm_read(connection &c)
+    {
+        auto space = c.in.free_space();
+        if (space.empty())
+            return reject(c, 431);
+
+        c.busy = true;
+        rio::as::read(ctx, c.sock, space, [](rio::context &, rio::result<std::size_t> n, connection *c) {
+            auto *self = c->srv;
+            c->busy = false;
+            if (!n || *n == 0 || c->closing)
+                return self->close(*c);
+            c->in.commit(*n);
+            c->last_active = std::chrono::steady_clock::now();
+            self->process(*c);
+        }, &c);
+    }
+
+    // Answers every complete request in the buffer, then writes them all or reads more.
+    void process(connection &c)
+    {
+        auto data = c.in.data();
+        std::string_view buf(data.data(), data.size());
+
+        while (!c.closing)
+        {
+            auto pending = buf.substr(c.consumed);
+            auto head = parse_head(pending, c.req, opts.parse);
+            if (!head)
+                return reject(c, status_of(head.error().code));
+            if (*head == 0)
+                break;
+
+            std::size_t used = *head;
+            if (c.req.chunked)
+            {
+                auto body = decode_chunked(pending.substr(*head), c.chunked_body, opts.parse);
+                if (!body)
+                    return reject(c, status_of(body.error().code));
+                // A full buffer only means too large when nothing before this request is waiting to be written out,
+                // otherwise the write releases that space and the body gets another read.
+                if (*body == 0)
+                {
+                    if (c.in.full() && c.consumed == 0)
+                        return reject(c, 413);
+                    break;
+                }
+                used += *body;
+                c.req.body = c.chunked_body;
+            }
+            else
+            {
+                if (pending.size() - *head < c.req.content_length)
+                {
+                    if (*head + c.req.content_length > c.in.capacity())
+                        return reject(c, 413);
+                    break;
+                }
+                c.req.body = pending.substr(*head, c.req.content_length);
+                used += c.req.content_length;
+            }
+
+            c.consumed += used;
+            ++st.requests;
+
+            auto &resp = c.out.emplace_back();
+            handler(c.req, resp);
+            resp.finish(c.req.method, c.req.minor_version, c.req.keep_alive);
+            if (!c.req.keep_alive)
+                c.closing = true;
+            // A chunked body lives in chunked_body, which the next request would overwrite.
+            if (c.req.chunked)
+                break;
+        }
+
+        if (!c.out.empty())
+            return write_out(c);
+        if (c.closing)
+            return close(c);
+        arm_read(c);
+    }
+
+    void write_out(connection &c)
+    {
+        c.iov.clear();
+        c.iov_at = 0;
+        for (auto &r : c.out) r.append_iov(c.iov);
+        flush(c);
+    }
+
+    void flush(connection &c)
+    {
+        c.busy = true;
+        ++st.writes;
+        // IOV_MAX per writev, the rest goes out on the next round.
+        auto batch = std::span<const iovec>(c.iov).subspan(c.iov_at, std::min<std::size_t>(c.iov.size() - c.iov_at, 1024));
+        rio::as::writev(ctx, c.sock, batch, [](rio::context &, rio::result<std::size_t> n, connection *c) {
+            auto *self = c->srv;
+            c->busy = false;
+            if (!n)
+                return self->close(*c);
+            self->advance(*c, *n);
+            if (c->iov_at < c->iov.size())
+                return self->flush(*c);
+
+            // Everything answered is on the wire: release its bytes and responses, then look for more.
+            c->out.clear();
+            c->in.consume(std::exchange(c->consumed, 0));
+            c->last_active = std::chrono::steady_clock::now();
+            if (c->closing)
+                return self->close(*c);
+            self->process(*c);
+        }, &c);
+    }
+
+    // Skips `n` written bytes in the iovec list (short writes).
+    static void advance(connection &c, std::size_t n)
+    {
+        while (n && c.iov_at < c.iov.size())
+        {
+            auto &v = c.iov[c.iov_at];
+            if (n < v.iov_len)
+            {
+                v.iov_base = static_cast<char *>(v.iov_base) + n;
+                v.iov_len -= n;
+                return;
+            }
+            n -= v.iov_len;
+            ++c.iov_at;
+        }
+    }
+
+    // Status answering a parse_head / decode_chunked failure.
+    static auto status_of(std::error_code ec) -> int
+    {
+        if (ec == std::errc::message_size)
+            return 431;
+        if (ec == std::errc::file_too_large)
+            return 413;
+        if (ec == std::errc::function_not_supported)
+            return 501;
+        return 400;
+    }
+
+    // Answers the offending request with an error status and closes after it.
+    void reject(connection &c, int status)
+    {
+        ++st.bad_requests;
+        c.closing = true;
+        auto &resp = c.out.emplace_back();
+        resp.status = status;
+        resp.finish({}, 1, false);
+        write_out(c);
+    }
+
+    // Only called with nothing in flight on the connection.
+    void close(connection &c)
+    {
+        conns.erase(c.id);
+        st.live = conns.size();
+    }
+
+    rio::context &ctx;
+    rio::Tcp_socket listener;
+    Handler handler;
+    server_options opts;
+    rio::timer_wheel wheel;
+    ticker_req ticker{};
+    std::unordered_map<std::uint64_t, std::unique_ptr<connection>> conns;
+    std::uint64_t next_id = 1;
+    server_stats st;
+    bool stopping = false;
+};
+
+}  // namespace rio::http
@@ -0,0 +1,140 @@
+module;
+
+#include <cerrno>
+#include <unistd.h>
+
+export module rio:io.buffered_reader;
+
+import std;
+
+import :io;
+import :utils;
+import :utils.simd;
+
+namespace rio::io {
+
+// Reads through a reusable buffer so line/delimiter parsing costs one syscall per buffer, not per byte.
+// Views returned by read_until/read_line point into the buffer and are invalidated by the next read call.
+export template <Has_Handle_C Resource>
+struct buffered_reader
+{
+    static constexpr std::size_t default_capacity = 64 * 1024;
+
+    Resource &resource;
+    std::vector<char> buf;
+    std::size_t head = 0;  // First unconsumed byte
+    std::size_t tail = 0;  // One past the last valid byte
+    bool at_eof = false;
+
+    explicit buffered_reader(Resource &r, std::size_t capacity = default_capacity) : resource(r), buf(std::max<std::size_t>(capacity, 64)) {}
+
+    buffered_reader(const buffered_reader &) = delete;
+    buffered_reader &operator=(const buffered_reader &) = delete;
+
+    // Bytes up to (not including) `delim`, the delimiter itself is consumed.
+    // The last record may be unterminated, nullopt only once everything is consumed.
+    auto read_until(char delim) -> result<std::optional<std::string_view>>
+    {
+        std::size_t scanned = head;
+
+        while (true)
+        {
+            const char *hit = rio::simd::find(buf.data() + scanned, buf.data() + tail, delim);
+            if (hit != buf.data() + tail)
+            {
+                std::string_view out(buf.data() + head, static_cast<std::size_t>(hit - (buf.data() + head)));
+                head = static_cast<std::size_t>(hit - buf.data()) + 1;
+                return out;
+            }
+
+            scanned = tail - head;  // Offsets shift after fill() compacts the buffer
+
+            if (at_eof)
+            {
+                if (head == tail)
+                    return std::nullopt;
+                std::string_view out(buf.data() + head, tail - head);
+                head = tail;
+                return out;
+            }
+
+            if (auto res = fill(); !res)
+                return std::unexpected(res.error());
+
+            scanned += head;
+        }
+    }
+
+    auto read_line() -> result<std::optional<std::string_view>> { return read_until('\n'); }
+
+    // Buffered bytes first, large remainders go straight to the kernel.
+    auto read(std::span<char> out) -> result<std::size_t>
+    {
+        if (head == tail)
+        {
+            if (at_eof)
+                return 0;
+            if (out.size() >= buf.size())
+                return raw_read(out);
+            if (auto res = fill(); !res)
+                return std::unexpected(res.error());
+        }
+
+        std::size_t n = std::min(out.size(), tail - head);
+        std::memcpy(out.data(), buf.data() + head, n);
+        head += n;
+        return n;
+    }
+
+    // Whatever is buffered, filling once if empty. Pair with consume().
+    auto peek() -> result<std::string_view>
+    {
+        if (head == tail && !at_eof)
+            if (auto res = fill(); !res)
+                return std::unexpected(res.error());
+        return std::string_view(buf.data() + head, tail - head);
+    }
+
+    void consume(std::size_t n) { head = std::min(head + n, tail); }
+
+    [[nodiscard]] auto buffered() const -> std::size_t { return tail - head; }
+    [[nodiscard]] auto eof() const -> bool { return at_eof && head == tail; }
+
+private:
+    auto raw_read(std::span<char> out) -> result<std::size_t>
+    {
+        while (true)
+        {
+            ssize_t n = ::read(static_cast<int>(resource.fd), out.data(), out.size());
+            if (n >= 0)
+                return static_cast<std::size_t>(n);
+            if (errno != EINTR)
+                return std::unexpected(Err{errno, "Buffered read failed"});
+        }
+    }
+
+    // Compacts, grows if a single record already fills the buffer, then reads once.
+    auto fill() -> result<void>
+    {
+        if (head > 0)
+        {
+            std::memmove(buf.data(), buf.data() + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+
+        if (tail == buf.size())
+            buf.resize(buf.size() * 2);
+
+        auto res = raw_read(std::span{buf}.subspan(tail));
+        if (!res)
+            return std::unexpected(res.error());
+
+        if (*res == 0)
+            at_eof = true;
+        tail += *res;
+        return {};
+    }
+};
+
+}  // namespace rio::io
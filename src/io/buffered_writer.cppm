@@ -0,0 +1,148 @@
+module;
+
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+export module rio:io.buffered_writer;
+
+import std;
+
+import :io;
+import :socket.tcp_socket;
+import :utils;
+
+namespace rio::io {
+
+// Coalesces small writes into one buffer and flushes everything queued with a single writev.
+// Small spans are copied, spans of at least `passthrough` bytes are never copied: write() flushes them
+// together with the buffer immediately, write_ref() queues them until the next flush.
+export template <Has_Handle_C Resource>
+struct buffered_writer
+{
+    static constexpr std::size_t default_capacity = 16 * 1024;
+
+    Resource &resource;
+    std::unique_ptr<char[]> buf;
+    std::size_t capacity;
+    std::size_t passthrough;
+    std::size_t used = 0;
+    std::vector<iovec> queued;
+
+    explicit buffered_writer(Resource &r, std::size_t cap = default_capacity)
+        : resource(r), buf(std::make_unique<char[]>(cap)), capacity(cap), passthrough(cap / 4)
+    {
+        queued.reserve(64);
+    }
+
+    buffered_writer(const buffered_writer &) = delete;
+    buffered_writer &operator=(const buffered_writer &) = delete;
+
+    ~buffered_writer() { (void)flush(); }
+
+    auto write(std::span<const char> data) -> result<void>
+    {
+        if (data.size() >= passthrough)
+        {
+            if (auto res = push(data); !res)
+                return res;
+            return flush();
+        }
+
+        if (used + data.size() > capacity || queued.size() == IOV_MAX)
+            if (auto res = flush(); !res)
+                return res;
+
+        // Extend the last iovec when it already ends at the buffer tail, keeps the iovec count down.
+        char *dst = buf.get() + used;
+        std::memcpy(dst, data.data(), data.size());
+        used += data.size();
+
+        if (!queued.empty() && static_cast<char *>(queued.back().iov_base) + queued.back().iov_len == dst)
+            queued.back().iov_len += data.size();
+        else
+            return push({dst, data.size()});
+        return {};
+    }
+
+    auto write(std::string_view s) -> result<void> { return write(std::span<const char>(s.data(), s.size())); }
+
+    // Zero-copy: `data` must stay alive and unchanged until the next flush().
+    auto write_ref(std::span<const char> data) -> result<void> { return push(data); }
+
+    auto flush() -> result<void>
+    {
+        std::size_t idx = 0;
+
+        while (idx < queued.size())
+        {
+            auto batch = std::span{queued}.subspan(idx, std::min<std::size_t>(queued.size() - idx, IOV_MAX));
+
+            ssize_t n = submit(batch);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                auto err = Err{errno, "Buffered write failed"};
+                reset();
+                return std::unexpected(err);
+            }
+
+            // Drop fully written iovecs, trim the partially written one and go again.
+            auto left = static_cast<std::size_t>(n);
+            while (idx < queued.size() && left >= queued[idx].iov_len) left -= queued[idx++].iov_len;
+            if (left)
+            {
+                queued[idx].iov_base = static_cast<char *>(queued[idx].iov_base) + left;
+                queued[idx].iov_len -= left;
+            }
+        }
+
+        reset();
+        return {};
+    }
+
+    [[nodiscard]] auto pending() const -> std::size_t
+    {
+        std::size_t total = 0;
+        for (const auto &v : queued) total += v.iov_len;
+        return total;
+    }
+
+private:
+    auto push(std::span<const char> data) -> result<void>
+    {
+        if (data.empty())
+            return {};
+        if (queued.size() == IOV_MAX)
+            if (auto res = flush(); !res)
+                return res;
+        queued.push_back({.iov_base = const_cast<char *>(data.data()), .iov_len = data.size()});
+        return {};
+    }
+
+    auto submit(std::span<iovec> v) -> ssize_t
+    {
+        const int fd = static_cast<int>(resource.fd);
+        if constexpr (std::same_as<std::remove_cv_t<Resource>, rio::Tcp_socket>)
+        {
+            // sendmsg for MSG_NOSIGNAL, same reasoning as io::write on sockets
+            msghdr msg{};
+            msg.msg_iov = v.data();
+            msg.msg_iovlen = v.size();
+            return ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        }
+        else
+            return ::writev(fd, v.data(), static_cast<int>(v.size()));
+    }
+
+    void reset()
+    {
+        queued.clear();
+        used = 0;
+    }
+};
+
+}  // namespace rio::io
@@ -0,0 +1,327 @@
+module;
+
+#include <liburing.h>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+export module rio:io.chunked_reader;
+
+import std;
+
+import :context;
+import :file;
+import :utils;
+import :utils.simd;
+
+namespace rio::io {
+
+export struct chunk_options
+{
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t chunk_size = 4ull << 20;
+    char delim = '\n';
+};
+
+export template <typename Fn>
+concept Chunk_fn_C = std::invocable<Fn &, std::size_t, std::string_view>;
+
+namespace detail {
+
+// Shared between workers: next chunk to claim, and the first failure.
+struct chunk_plan
+{
+    std::size_t total_size;
+    std::size_t chunk_size;
+    std::size_t chunks;
+    char delim;
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> stop{false};
+    std::mutex err_mtx;
+    std::optional<Err> err;
+    std::exception_ptr ex;
+
+    chunk_plan(std::size_t size, const chunk_options &o)
+        : total_size(size), chunk_size(std::max<std::size_t>(o.chunk_size, 1)), chunks((size + chunk_size - 1) / chunk_size), delim(o.delim) {}
+
+    auto claim() -> std::optional<std::size_t>
+    {
+        if (stop.load(std::memory_order_relaxed))
+            return std::nullopt;
+        std::size_t k = next.fetch_add(1, std::memory_order_relaxed);
+        return k < chunks ? std::optional{k} : std::nullopt;
+    }
+
+    void fail(Err e)
+    {
+        std::lock_guard lock(err_mtx);
+        if (!err && !ex)
+            err = std::move(e);
+        stop = true;
+    }
+
+    void fail(std::exception_ptr p)
+    {
+        std::lock_guard lock(err_mtx);
+        if (!err && !ex)
+            ex = p;
+        stop = true;
+    }
+
+    auto finish() -> result<void>
+    {
+        if (ex)
+            std::rethrow_exception(ex);
+        if (err)
+            return std::unexpected(*err);
+        return {};
+    }
+};
+
+// Records owned by chunk k are the ones that start in [k * size, (k + 1) * size).
+// `lead_is_delim` tells whether the byte before the chunk ends a record (always true for chunk 0).
+// Returns the offset of the first owned record inside `data`, or npos if no record starts in it: the chunk is
+// entirely one foreign record, or that record ends on its last byte and the next one belongs to the next chunk.
+inline auto first_record(std::string_view data, bool lead_is_delim, char delim) -> std::size_t
+{
+    if (lead_is_delim)
+        return 0;
+    auto pos = rio::simd::find(data, delim);
+    return pos == std::string_view::npos || pos + 1 == data.size() ? std::string_view::npos : pos + 1;
+}
+
+template <typename Fn>
+void run_workers(chunk_plan &plan, std::size_t workers, Fn &&body)
+{
+    workers = std::clamp<std::size_t>(workers, 1, std::max<std::size_t>(plan.chunks, 1));
+    std::vector<std::jthread> pool;
+    pool.reserve(workers);
+
+    for (std::size_t w = 0; w < workers; ++w)
+        pool.emplace_back([&plan, &body, w] {
+            try
+            {
+                body(w);
+            }
+            catch (...)
+            {
+                plan.fail(std::current_exception());
+            }
+        });
+}
+
+}  // namespace detail
+
+// Splits a mapped file into record-aligned chunks and calls fn(worker, chunk) from `workers` threads.
+// Each worker claims chunks two at a time and madvise(WILLNEED)s the next one through its own ring
+// while it parses the current one. fn is called concurrently and must be thread safe.
+export template <Chunk_fn_C Fn>
+auto for_each_chunk(const rio::mapped_file &m, Fn &&fn, chunk_options opts = {}) -> result<void>
+{
+    detail::chunk_plan plan(m.size, opts);
+    const std::string_view all = m.view();
+
+    detail::run_workers(plan, opts.workers, [&](std::size_t w) {
+        rio::context ctx(8);
+
+        auto prefetch = [&](std::size_t k) {
+            // madvise wants a page aligned start, the mapping itself is.
+            std::size_t off = (k * plan.chunk_size) & ~std::size_t{4095};
+            std::size_t len = std::min(plan.chunk_size + 4096, all.size() - off);
+            auto *sqe = ctx.sqe();
+            io_uring_prep_madvise(sqe, const_cast<char *>(all.data() + off), static_cast<off_t>(len), MADV_WILLNEED);
+            io_uring_sqe_set_data(sqe, nullptr);
+            ctx.submit();
+        };
+
+        auto cur = plan.claim();
+        if (cur)
+            prefetch(*cur);
+
+        while (cur)
+        {
+            auto nxt = plan.claim();
+            if (nxt)
+                prefetch(*nxt);
+
+            std::size_t begin = *cur * plan.chunk_size;
+            std::size_t nominal_end = std::min(begin + plan.chunk_size, all.size());
+
+            std::size_t start = detail::first_record(all.substr(begin, nominal_end - begin), begin == 0 || all[begin - 1] == plan.delim, plan.delim);
+            if (start != std::string_view::npos)
+            {
+                // Last owned record may run past the nominal end, finish it.
+                std::size_t end = nominal_end;
+                if (end < all.size() && all[end - 1] != plan.delim)
+                {
+                    auto pos = rio::simd::find(all.substr(end), plan.delim);
+                    end = (pos == std::string_view::npos) ? all.size() : end + pos + 1;
+                }
+                fn(w, all.substr(begin + start, end - begin - start));
+            }
+
+            ctx.try_poll();
+            cur = nxt;
+        }
+    });
+
+    return plan.finish();
+}
+
+// Same contract as the mapped overload, but reads with pread through each worker's ring into two
+// buffers, so chunk k + 1 is in flight while chunk k is being parsed.
+export template <Chunk_fn_C Fn>
+auto for_each_chunk(const rio::file &f, Fn &&fn, chunk_options opts = {}) -> result<void>
+{
+    struct stat st{};
+    if (::fstat(f.fd, &st) == -1)
+        return std::unexpected(Err::sys("Failed to size file for chunked read"));
+
+    detail::chunk_plan plan(static_cast<std::size_t>(st.st_size), opts);
+    const int fd = f.fd;
+
+    detail::run_workers(plan, opts.workers, [&](std::size_t w) {
+        // Each read starts one byte early (except chunk 0) so we know whether a record ends right before us.
+        struct slot
+        {
+            std::vector<char> buf;
+            std::size_t chunk = 0;
+            std::size_t lead = 0;
+        };
+        // Before the ring, so the buffers outlive it: reads still in flight are drained by the guard below.
+        std::array<slot, 2> slots;
+        for (auto &s : slots) s.buf.resize(plan.chunk_size + 1);
+        std::array<bool, 2> in_flight{};
+
+        rio::context ctx(8);
+
+        auto issue = [&](slot &s, std::size_t k) {
+            s.chunk = k;
+            s.lead = k ? 1 : 0;
+            std::size_t off = k * plan.chunk_size - s.lead;
+            std::size_t len = std::min(plan.chunk_size + s.lead, plan.total_size - off);
+            s.buf.resize(plan.chunk_size + 1);
+
+            auto *sqe = ctx.sqe();
+            io_uring_prep_read(sqe, fd, s.buf.data(), static_cast<unsigned>(len), off);
+            io_uring_sqe_set_data(sqe, &s);
+            in_flight[static_cast<std::size_t>(&s - slots.data())] = true;
+            ctx.submit();
+        };
+
+        // Completions land out of order relative to the two slots, stash them per slot. The context's inbox
+        // wakeup shares the ring, anything that is not one of our slots is skipped.
+        std::array<std::optional<int>, 2> landed;
+        auto wait_for = [&](slot &s) -> int {
+            std::size_t idx = static_cast<std::size_t>(&s - slots.data());
+            while (!landed[idx])
+            {
+                io_uring_cqe *cqe;
+                if (int ret = io_uring_wait_cqe(&ctx.ring, &cqe); ret < 0)
+                {
+                    if (ret == -EINTR)
+                        continue;
+                    return ret;
+                }
+                auto *data = io_uring_cqe_get_data(cqe);
+                for (std::size_t i = 0; i < slots.size(); ++i)
+                    if (data == &slots[i])
+                    {
+                        landed[i] = cqe->res;
+                        in_flight[i] = false;
+                    }
+                io_uring_cqe_seen(&ctx.ring, cqe);
+            }
+            return *std::exchange(landed[idx], std::nullopt);
+        };
+
+        // Runs on every exit, fn throwing included: no read may outlive the buffers it writes into.
+        auto drain = rio::make_scope_guard([&]() noexcept {
+            for (std::size_t i = 0; i < slots.size(); ++i)
+                if (in_flight[i])
+                    wait_for(slots[i]);
+        });
+
+        auto cur_k = plan.claim();
+        std::size_t cur = 0;
+        if (cur_k)
+            issue(slots[cur], *cur_k);
+
+        while (cur_k)
+        {
+            auto nxt_k = plan.claim();
+            if (nxt_k)
+                issue(slots[cur ^ 1], *nxt_k);
+
+            slot &s = slots[cur];
+            int res = wait_for(s);
+            if (res < 0)
+            {
+                plan.fail(Err{-res, "Chunk read failed"});
+                return;
+            }
+
+            // A read shorter than the lead byte means the file shrank under us, nothing to own.
+            std::size_t n = static_cast<std::size_t>(res);
+            std::string_view body(s.buf.data() + s.lead, n > s.lead ? n - s.lead : 0);
+            bool lead_is_delim = !s.lead || s.buf[0] == plan.delim;
+
+            std::size_t start = body.empty() ? std::string_view::npos : detail::first_record(body, lead_is_delim, plan.delim);
+            if (start != std::string_view::npos)
+            {
+                // Spill: keep reading synchronously until the last owned record is terminated.
+                std::size_t file_off = s.chunk * plan.chunk_size + body.size();
+                std::size_t have = s.lead + body.size();
+                s.buf.resize(have);
+
+                if (file_off < plan.total_size && s.buf.back() != plan.delim)
+                {
+                    char tmp[4096];
+                    while (file_off < plan.total_size)
+                    {
+                        ssize_t got = ::pread(fd, tmp, sizeof(tmp), static_cast<off_t>(file_off));
+                        if (got < 0 && errno == EINTR)
+                            continue;
+                        if (got <= 0)
+                            break;
+
+                        std::string_view part(tmp, static_cast<std::size_t>(got));
+                        auto pos = rio::simd::find(part, plan.delim);
+                        std::size_t take = pos == std::string_view::npos ? part.size() : pos + 1;
+                        s.buf.insert(s.buf.end(), tmp, tmp + take);
+                        file_off += take;
+                        if (pos != std::string_view::npos)
+                            break;
+                    }
+                }
+
+                fn(w, std::string_view(s.buf.data() + s.lead + start, s.buf.size() - s.lead - start));
+            }
+
+            cur ^= 1;
+            cur_k = nxt_k;
+        }
+    });
+
+    return plan.finish();
+}
+
+// Record granularity on top of for_each_chunk: fn(worker, record) without the delimiter.
+export template <typename Source, Chunk_fn_C Fn>
+auto for_each_record(const Source &src, Fn &&fn, chunk_options opts = {}) -> result<void>
+{
+    const char delim = opts.delim;
+    return for_each_chunk(src, [&fn, delim](std::size_t w, std::string_view chunk) {
+        const char *p = chunk.data();
+        const char *end = p + chunk.size();
+        while (p < end)
+        {
+            const char *hit = rio::simd::find(p, end, delim);
+            fn(w, std::string_view(p, static_cast<std::size_t>(hit - p)));
+            p = hit + 1;
+        }
+    }, opts);
+}
+
+}  // namespace rio::io
@@ -69,6 +69,7 @@ export auto read(const rio::handle& h) -> result<std::string>
     return out;
 }
 
+// One syscall per byte, use io::buffered_reader for anything bigger than a prompt.
 export auto read_line(const rio::handle& fd) -> result<std::string>
 {
     __Check_Handle_M(fd);
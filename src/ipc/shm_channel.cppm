@@ -0,0 +1,395 @@
+module;
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+
+export module rio:ipc.shm_channel;
+
+import std;
+import :utils;
+import :handle;
+import :context;
+import :futures;
+import :fut.futex;
+
+namespace rio {
+
+// Lives in the first page of the memfd, shared by every process that maps it.
+struct shm_header
+{
+    static constexpr std::uint64_t magic_v = 0x72696f2d73686d32;  // "rio-shm2"
+
+    std::uint64_t magic;
+    std::uint64_t capacity;
+
+    alignas(64) std::atomic<std::uint64_t> head{0};  // Reserved by writers
+    alignas(64) std::atomic<std::uint64_t> tail{0};  // Consumed by the reader
+
+    // Futex words (shared, not private: the waiters live in other processes).
+    alignas(64) std::atomic<std::uint32_t> data_seq{0};
+    std::atomic<std::uint32_t> reader_waiting{0};
+    alignas(64) std::atomic<std::uint32_t> space_seq{0};
+    std::atomic<std::uint32_t> writers_waiting{0};
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shm_channel needs address-free 64-bit atomics");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "shm_channel needs address-free 32-bit atomics");
+
+// Message framing inside the ring, payload follows and is padded to 8 bytes.
+// `word` is the commit marker: 0 until the writer publishes len | published with release.
+struct shm_record
+{
+    static constexpr std::uint32_t published = 1u << 31;
+
+    std::atomic<std::uint32_t> word;
+    std::uint32_t reserved;
+};
+
+void futex_wake_shared(std::atomic<std::uint32_t> &word, int count)
+{
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+// Byte ring in a memfd, for messages between processes on one host (or threads, it doesn't care).
+// One reader, any number of writers. Messages are variable length and never copied by the channel:
+// writers fill a reservation in place, the reader gets a view of the shared pages.
+//
+// The data pages are mapped twice back to back, so every record is contiguous even when it wraps.
+// Writers reserve with a CAS on `head` and publish each record on its own by storing its length word,
+// never waiting on each other. The reader stops at the first unpublished record and zeroes what it
+// releases, so free space never looks published. Lengths come from peer-writable memory: a record that
+// doesn't fit what was reserved marks the channel corrupt instead of being handed out.
+// Waiting sides sleep on futex words in the header: a context waits through a ring FUTEX_WAIT, the other
+// side wakes it with a plain FUTEX_WAKE, no helper thread and no eventfd.
+export struct shm_channel
+{
+    struct reservation
+    {
+        std::span<std::byte> data;
+        std::uint64_t pos;
+    };
+
+    // Capacity is rounded up to whole pages.
+    static auto create(std::string_view name, std::size_t capacity) -> result<shm_channel>;
+
+    // Maps a channel created elsewhere, `fd` typically came over a Unix socket or through fork(). Takes ownership.
+    static auto attach(int fd) -> result<shm_channel>;
+
+    shm_channel(shm_channel &&other) noexcept;
+    shm_channel &operator=(shm_channel &&other) noexcept;
+    shm_channel(const shm_channel &) = delete;
+    shm_channel &operator=(const shm_channel &) = delete;
+    ~shm_channel();
+
+    [[nodiscard]] auto fd() const -> int { return memfd.native_handle(); }
+    [[nodiscard]] auto capacity() const -> std::size_t { return cap; }
+    [[nodiscard]] auto max_message() const -> std::size_t
+    {
+        return std::min<std::size_t>(cap - sizeof(shm_record), shm_record::published - 1);
+    }
+    // A peer wrote a record that can't be valid, nothing more is read from the channel.
+    [[nodiscard]] auto corrupt() const -> bool { return broken; }
+
+    // --- Writers ---
+    // Space for a len byte message, nullopt when the ring is full right now. Must be committed.
+    auto try_reserve(std::size_t len) -> std::optional<reservation>;
+    void commit(const reservation &r);
+    // Copying convenience, false when full.
+    auto try_write(std::span<const std::byte> msg) -> bool;
+
+    // --- Reader ---
+    // View of the oldest message, stays valid (and stays in the ring) until release(). nullopt once corrupt().
+    auto try_read() -> std::optional<std::span<const std::byte>>;
+    void release();
+
+    // --- Futures, waiting on `ctx`'s ring ---
+    // Resolves with the next message, release() it when done. Errors with bad_message once corrupt().
+    // The channel must outlive the future.
+    auto recv(rio::context &ctx);
+    // Resolves with a reservation once there is room. Errors with message_size if len can never fit.
+    auto reserve(rio::context &ctx, std::size_t len);
+    // Copies msg in once there is room.
+    auto send(rio::context &ctx, std::span<const std::byte> msg);
+
+private:
+    shm_channel(rio::handle fd, std::byte *base, std::size_t capacity);
+
+    static auto map(rio::handle fd, std::size_t capacity, bool init) -> result<shm_channel>;
+    static auto record_size(std::size_t len) -> std::size_t { return (sizeof(shm_record) + len + 7) & ~std::size_t{7}; }
+
+    [[nodiscard]] auto header() const -> shm_header * { return reinterpret_cast<shm_header *>(base); }
+    [[nodiscard]] auto at(std::uint64_t pos) const -> std::byte * { return base + page + pos % cap; }
+
+    void notify_reader();
+    void notify_writers();
+
+    using wait_future = decltype(fut::futex_wait(std::declval<rio::context &>(), std::declval<std::atomic<std::uint32_t> &>(), 0u, true));
+
+    template <typename TryFn>
+    struct wait_op
+    {
+        shm_channel *ch;
+        rio::context *ctx;
+        TryFn attempt;
+        bool reader;
+        std::optional<wait_future> wait{};
+    };
+
+    // Runs `attempt` (returns fut::res, pending = not yet), parks on the matching futex word when it can't proceed.
+    template <typename TryFn>
+    auto make_wait(rio::context &ctx, bool reader, TryFn attempt);
+
+    rio::handle memfd;
+    std::byte *base = nullptr;
+    std::size_t cap = 0;
+    std::size_t page = 0;
+    std::size_t reading = 0;  // Record size of the message handed out by try_read, 0 if none
+    bool broken = false;
+};
+
+shm_channel::shm_channel(rio::handle fd, std::byte *b, std::size_t capacity)
+    : memfd(std::move(fd)), base(b), cap(capacity), page(static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)))
+{}
+
+shm_channel::shm_channel(shm_channel &&other) noexcept
+    : memfd(std::move(other.memfd)), base(std::exchange(other.base, nullptr)), cap(other.cap), page(other.page), reading(other.reading),
+      broken(other.broken)
+{}
+
+shm_channel &shm_channel::operator=(shm_channel &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (base)
+            ::munmap(base, page + 2 * cap);
+        memfd = std::move(other.memfd);
+        base = std::exchange(other.base, nullptr);
+        cap = other.cap;
+        page = other.page;
+        reading = other.reading;
+        broken = other.broken;
+    }
+    return *this;
+}
+
+shm_channel::~shm_channel()
+{
+    if (base)
+        ::munmap(base, page + 2 * cap);
+}
+
+auto shm_channel::map(rio::handle fd, std::size_t capacity, bool init) -> result<shm_channel>
+{
+    const auto pg = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    // Header page, then the data pages twice.
+    auto mapped = map_mirrored(fd.native_handle(), pg, capacity);
+    if (!mapped)
+        return std::unexpected(mapped.error());
+
+    auto *b = *mapped;
+    if (init)
+        new (b) shm_header{.magic = shm_header::magic_v, .capacity = capacity};
+
+    return shm_channel(std::move(fd), b, capacity);
+}
+
+auto shm_channel::create(std::string_view name, std::size_t capacity) -> result<shm_channel>
+{
+    const auto pg = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    capacity = std::max((capacity + pg - 1) / pg * pg, pg);
+
+    rio::handle fd(::memfd_create(std::string(name).c_str(), MFD_CLOEXEC));
+    if (!fd)
+        return std::unexpected(Err::sys("memfd_create failed"));
+    if (::ftruncate(fd.native_handle(), static_cast<off_t>(pg + capacity)) != 0)
+        return std::unexpected(Err::sys("Failed to size shm_channel memfd"));
+
+    return map(std::move(fd), capacity, true);
+}
+
+auto shm_channel::attach(int raw) -> result<shm_channel>
+{
+    rio::handle fd(raw);
+    const auto pg = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    struct stat st{};
+    if (::fstat(fd.native_handle(), &st) != 0)
+        return std::unexpected(Err::sys("fstat on shm_channel fd failed"));
+    if (static_cast<std::size_t>(st.st_size) <= pg || (static_cast<std::size_t>(st.st_size) - pg) % pg != 0)
+        return std::unexpected(Err::app(std::errc::invalid_argument, "Not a shm_channel memfd"));
+
+    auto capacity = static_cast<std::size_t>(st.st_size) - pg;
+    auto ch = map(std::move(fd), capacity, false);
+    if (ch && (ch->header()->magic != shm_header::magic_v || ch->header()->capacity != capacity))
+        return std::unexpected(Err::app(std::errc::invalid_argument, "shm_channel header mismatch"));
+    return ch;
+}
+
+auto shm_channel::try_reserve(std::size_t len) -> std::optional<reservation>
+{
+    auto *h = header();
+    if (len > max_message())
+        return std::nullopt;
+    const std::size_t need = record_size(len);
+
+    std::uint64_t pos = h->head.load(std::memory_order_relaxed);
+    do
+    {
+        if (pos + need - h->tail.load(std::memory_order_acquire) > cap)
+            return std::nullopt;
+    } while (!h->head.compare_exchange_weak(pos, pos + need, std::memory_order_relaxed));
+
+    // The length word stays 0 (the reader zeroed it on release) until commit.
+    auto *rec = reinterpret_cast<shm_record *>(at(pos));
+    return reservation{.data = {reinterpret_cast<std::byte *>(rec + 1), len}, .pos = pos};
+}
+
+void shm_channel::commit(const reservation &r)
+{
+    auto *rec = reinterpret_cast<shm_record *>(at(r.pos));
+    rec->word.store(static_cast<std::uint32_t>(r.data.size()) | shm_record::published, std::memory_order_release);
+    notify_reader();
+}
+
+auto shm_channel::try_write(std::span<const std::byte> msg) -> bool
+{
+    auto r = try_reserve(msg.size());
+    if (!r)
+        return false;
+    std::memcpy(r->data.data(), msg.data(), msg.size());
+    commit(*r);
+    return true;
+}
+
+auto shm_channel::try_read() -> std::optional<std::span<const std::byte>>
+{
+    if (broken)
+        return std::nullopt;
+
+    auto *h = header();
+    std::uint64_t pos = h->tail.load(std::memory_order_relaxed);
+    auto *rec = reinterpret_cast<const shm_record *>(at(pos));
+    std::uint32_t word = rec->word.load(std::memory_order_acquire);
+    if (!(word & shm_record::published))
+        return std::nullopt;
+
+    // Must lie inside what writers reserved, anything else would send the view (and release) out of the ring.
+    std::size_t len = word & ~shm_record::published;
+    if (len > max_message() || record_size(len) > h->head.load(std::memory_order_acquire) - pos)
+    {
+        broken = true;
+        return std::nullopt;
+    }
+
+    reading = record_size(len);
+    return std::span(reinterpret_cast<const std::byte *>(rec + 1), len);
+}
+
+void shm_channel::release()
+{
+    if (!reading)
+        return;
+    auto *h = header();
+    std::uint64_t pos = h->tail.load(std::memory_order_relaxed);
+    // Zero the whole record, a later record header may land anywhere inside it.
+    std::memset(at(pos), 0, reading);
+    h->tail.store(pos + std::exchange(reading, 0), std::memory_order_release);
+    notify_writers();
+}
+
+void shm_channel::notify_reader()
+{
+    auto *h = header();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (h->reader_waiting.load(std::memory_order_relaxed) && h->reader_waiting.exchange(0, std::memory_order_acq_rel))
+    {
+        h->data_seq.fetch_add(1, std::memory_order_release);
+        futex_wake_shared(h->data_seq, 1);
+    }
+}
+
+void shm_channel::notify_writers()
+{
+    auto *h = header();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (h->writers_waiting.load(std::memory_order_relaxed) && h->writers_waiting.exchange(0, std::memory_order_acq_rel))
+    {
+        h->space_seq.fetch_add(1, std::memory_order_release);
+        futex_wake_shared(h->space_seq, INT_MAX);
+    }
+}
+
+template <typename TryFn>
+auto shm_channel::make_wait(rio::context &ctx, bool reader, TryFn attempt)
+{
+    using R = std::invoke_result_t<TryFn &, shm_channel &>;
+
+    return rio::Future(wait_op<TryFn>{this, &ctx, std::move(attempt), reader}, [](wait_op<TryFn> &o) -> R {
+        if (o.wait)
+        {
+            if (rio::poll(*o.wait).state == fut::status::pending)
+                return R::pending();
+            o.wait.reset();
+        }
+
+        if (auto r = o.attempt(*o.ch); r.state != fut::status::pending)
+            return r;
+
+        auto *h = o.ch->header();
+        auto &seq = o.reader ? h->data_seq : h->space_seq;
+        auto &flag = o.reader ? h->reader_waiting : h->writers_waiting;
+
+        // Flag, then re-check: the other side either sees the flag or we see its progress.
+        std::uint32_t seen = seq.load(std::memory_order_acquire);
+        flag.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (auto r = o.attempt(*o.ch); r.state != fut::status::pending)
+            return r;
+
+        // Without ring futex support the loop's next poll is our wakeup.
+        if (o.ctx->has_ring_futex())
+            o.wait.emplace(fut::futex_wait(*o.ctx, seq, seen, true));
+        return R::pending();
+    });
+}
+
+auto shm_channel::recv(rio::context &ctx)
+{
+    return make_wait(ctx, true, [](shm_channel &ch) -> fut::res<std::span<const std::byte>> {
+        if (auto m = ch.try_read())
+            return fut::res<std::span<const std::byte>>::ready(*m);
+        if (ch.broken)
+            return fut::res<std::span<const std::byte>>::error(std::errc::bad_message);
+        return fut::res<std::span<const std::byte>>::pending();
+    });
+}
+
+auto shm_channel::reserve(rio::context &ctx, std::size_t len)
+{
+    return make_wait(ctx, false, [len](shm_channel &ch) -> fut::res<reservation> {
+        if (len > ch.max_message())
+            return fut::res<reservation>::error(std::errc::message_size);
+        if (auto r = ch.try_reserve(len))
+            return fut::res<reservation>::ready(*r);
+        return fut::res<reservation>::pending();
+    });
+}
+
+auto shm_channel::send(rio::context &ctx, std::span<const std::byte> msg)
+{
+    return make_wait(ctx, false, [msg](shm_channel &ch) -> fut::res<void> {
+        if (msg.size() > ch.max_message())
+            return fut::res<void>::error(std::errc::message_size);
+        if (!ch.try_write(msg))
+            return fut::res<void>::pending();
+        return fut::res<void>::ready();
+    });
+}
+
+}  // namespace rio
@@ -0,0 +1,19 @@
+#pragma once
+
+// Ring futex support, for the global module fragments of the context and fut.futex partitions.
+
+#include <liburing.h>
+#include <linux/futex.h>
+
+// IORING_OP_FUTEX_WAIT/WAKE helpers came with liburing 2.5, the kernel side with 6.7.
+#if defined(IO_URING_CHECK_VERSION) && !IO_URING_CHECK_VERSION(2, 5)
+#define RIO_HAS_RING_FUTEX 1
+#else
+#define RIO_HAS_RING_FUTEX 0
+#endif
+#ifndef FUTEX2_SIZE_U32
+#define FUTEX2_SIZE_U32 0x02
+#endif
+#ifndef FUTEX2_PRIVATE
+#define FUTEX2_PRIVATE 128
+#endif
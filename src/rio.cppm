@@ -8,6 +8,9 @@ export module rio;
 import std;
 
 export import :io;
+export import :io.buffered_reader;
+export import :io.buffered_writer;
+export import :io.chunked_reader;
 export import :utils;
 export import :handle;
 export import :file;
@@ -17,6 +20,22 @@ export import :asio;
 export import :futures;
 export import :promise;
 export import :fut.io;
+export import :fut.atomic_promise;
+export import :fut.channel;
+export import :fut.sync;
+export import :fut.futex;
+export import :fut.pool;
+export import :fut.pipeline;
+export import :fut.framing;
+export import :fut.task;
+export import :fut.blocking;
+export import :runtime;
+export import :executor;
+export import :storage.wal;
+export import :storage.block_cache;
+export import :ipc.shm_channel;
+export import :http.parser;
+export import :http.server;
 
 namespace rio {
 export auto kill(rio::handle &h) -> void
@@ -0,0 +1,483 @@
+module;
+
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+
+export module rio:runtime;
+
+import std;
+import :context;
+import :socket;
+import :utils;
+import :futures;
+import :fut.task;
+import :fut.io;
+
+namespace rio {
+
+// When the busiest worker's load (completions over the last interval) exceeds the idlest one's by `skew`,
+// the busiest is asked to shed `max_moves` connections to the idlest. Connections leave cooperatively,
+// see worker::claim_migration.
+export struct rebalance_policy
+{
+    double skew = 1.5;
+    std::uint64_t min_load = 1000;  // Busiest worker's completions per interval below this: not worth moving anything
+    std::uint32_t max_moves = 4;
+    std::chrono::milliseconds interval{1000};
+};
+
+export struct runtime_options
+{
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> cpus{};  // cpus[i] for worker i, empty means worker i -> cpu i
+    unsigned ring_entries = 256;
+
+    // When set, every worker gets its own SO_REUSEPORT listener bound to this address.
+    std::optional<rio::address> listen{};
+    s_opt listen_options = s_opt::async_server_v4;
+    int backlog = 1024;
+    bool steer_by_cpu = true;  // Connections go to the listener of the cpu that received them (listener_group)
+
+    // Each worker prefers its cpu's NUMA node for everything it allocates: ring, requests, buffers, sessions.
+    bool numa_local = false;
+
+    // Periodic load rebalancing by connection migration, off when unset. See rebalance_policy.
+    std::optional<rebalance_policy> rebalance{};
+
+    // Upper bound on how long an idle worker sleeps in the ring before re-polling its tasks and the stop flag.
+    std::chrono::milliseconds tick{10};
+};
+
+// Counters are written by the owning worker only, relaxed atomics so other threads can sample them.
+export struct worker_stats
+{
+    std::atomic<std::uint64_t> loops{0};
+    std::atomic<std::uint64_t> completions{0};
+    std::atomic<std::uint64_t> spawned{0};
+    std::atomic<std::uint64_t> finished{0};
+    std::atomic<std::uint64_t> failed{0};
+    std::atomic<std::uint64_t> live{0};
+    std::atomic<std::uint64_t> migrated_in{0};
+    std::atomic<std::uint64_t> migrated_out{0};
+    std::atomic<int> pin_error{0};   // errno from pinning the thread to its cpu, 0 when pinned
+    std::atomic<int> numa_error{0};  // errno from preferring its NUMA node, 0 when placed (or not asked to)
+};
+
+export struct worker_snapshot
+{
+    std::size_t id;
+    int cpu;
+    int node;
+    std::uint64_t loops, completions, spawned, finished, failed, live;
+    std::uint64_t migrated_in, migrated_out;
+    int pin_error, numa_error;
+};
+
+// Where each worker's ring memory ended up.
+export struct numa_report
+{
+    struct worker_placement
+    {
+        std::size_t id;
+        int cpu;
+        int node;
+        numa::placement ring;
+    };
+
+    std::vector<worker_placement> workers;
+};
+
+export struct runtime;
+
+// One pinned thread, one ring, one task set. Everything here belongs to the worker's thread.
+export struct worker
+{
+    std::size_t id;
+    int cpu;
+    int node = -1;  // Set when runtime_options::numa_local is on
+    rio::runtime &rt;
+    std::optional<rio::context> ctx{};  // Built on the worker thread after pinning, so ring memory is first-touched locally.
+    std::optional<rio::Tcp_socket> listener{};
+    std::vector<fut::task> tasks;
+    worker_stats stats;
+    std::atomic<bool> running{false};  // Between context creation and the end of its loop, migrate() checks it
+    std::mutex migrate_mtx;            // Orders migrate()'s check and post against the worker stopping
+
+    // Written by the rebalancer: how many connections to hand over, and to which worker.
+    std::atomic<std::uint32_t> shed_quota{0};
+    std::atomic<std::size_t> shed_to{0};
+
+    worker(std::size_t i, int c, rio::runtime &r) : id(i), cpu(c), rt(r) {}
+
+    // Only from this worker's thread.
+    template <Pollable F>
+    void spawn(F &&f)
+    {
+        tasks.emplace_back(std::forward<F>(f));
+        stats.spawned.fetch_add(1, std::memory_order_relaxed);
+        stats.live.store(tasks.size(), std::memory_order_relaxed);
+    }
+
+    // Polls every task once, drops the ones that finished. Returns how many are still pending.
+    auto poll_tasks() -> std::size_t
+    {
+        for (std::size_t i = tasks.size(); i-- > 0;)
+        {
+            auto st = tasks[i].poll();
+            if (st == fut::status::pending)
+                continue;
+
+            (st == fut::status::ready ? stats.finished : stats.failed).fetch_add(1, std::memory_order_relaxed);
+            if (i != tasks.size() - 1)
+                tasks[i] = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        stats.live.store(tasks.size(), std::memory_order_relaxed);
+        return tasks.size();
+    }
+
+    // Connection tasks ask between requests, when nothing is in flight on their socket (or after fut::cancel_fd).
+    // A worker id means "move there now" with runtime::migrate. Each claim uses up one unit of the quota.
+    auto claim_migration() -> std::optional<std::size_t>
+    {
+        auto q = shed_quota.load(std::memory_order_acquire);
+        while (q && !shed_quota.compare_exchange_weak(q, q - 1, std::memory_order_acq_rel)) {}
+        if (!q)
+            return std::nullopt;
+        return shed_to.load(std::memory_order_relaxed);
+    }
+};
+
+// Thread-per-core runtime: N workers, each pinned to a cpu with its own context, listener and tasks.
+// Nothing is shared between workers, scale comes from the kernel spreading connections over the
+// SO_REUSEPORT group.
+export struct runtime
+{
+    using setup_fn = std::function<void(worker &)>;
+
+    runtime_options opts;
+    std::vector<std::unique_ptr<worker>> workers;
+    std::vector<std::jthread> threads;
+    std::atomic<bool> stopping{false};
+
+    explicit runtime(runtime_options o = {}) : opts(std::move(o)) {}
+    ~runtime()
+    {
+        stop();
+        join();
+    }
+
+    runtime(const runtime &) = delete;
+    runtime &operator=(const runtime &) = delete;
+
+    // Opens listeners on the calling thread (so errors come back here), then starts the workers.
+    // `setup` runs once on each worker thread, after pinning and context creation.
+    auto start(setup_fn setup) -> result<void>;
+
+    // Asks every worker to exit, each one notices within one tick.
+    void stop() { stopping.store(true, std::memory_order_release); }
+
+    // Restart handoff. The successor calls adopt_listeners() with what receive_handoff() gave it before
+    // start(), one listener per worker in the order they were sent; listen / listen_options are then unused.
+    auto adopt_listeners(std::vector<Tcp_socket> inherited) -> result<void>;
+    // What the predecessor passes to handoff_server::serve, "listener.<worker id>" in group order. Call after start()
+    // and serve before drain(): a worker closes its listener on exit, the fds are only valid until then.
+    [[nodiscard]] auto handoff_entries() const -> std::vector<handoff_entry>;
+
+    // Stops accepting: each worker cancels the accept in flight on its listener, then exits once its tasks
+    // finished or after `grace`, closing the listener on the way out. Accept loops should check draining() and not re-arm.
+    void drain(std::chrono::milliseconds grace = std::chrono::seconds{30});
+    [[nodiscard]] auto draining() const -> bool { return drain_deadline.load(std::memory_order_acquire) != 0; }
+    void join() { threads.clear(); }
+
+    [[nodiscard]] auto running() const -> bool { return !stopping.load(std::memory_order_acquire); }
+    [[nodiscard]] auto stats() const -> std::vector<worker_snapshot>;
+
+    // Moves a quiesced connection to worker `to`: the socket and its session go over the target's inbox and
+    // adopt(worker &, Tcp_socket, Session) runs on the target thread, typically to spawn the connection task there.
+    // Call from `from`'s thread with no op left in flight on `sock` in from's ring.
+    // When `to` is out of range or that worker is no longer running, adopt runs on `from` right away and it returns false.
+    // True means the connection went to `to`'s inbox. If `to` stops before running it, it is handed back to `from`
+    // (or, when `from` has stopped as well, adopted by `to` on its way out and closed with its tasks).
+    template <typename Session, typename Adopt>
+    requires std::invocable<Adopt &, worker &, Tcp_socket, Session>
+    auto migrate(worker &from, std::size_t to, Tcp_socket sock, Session session, Adopt adopt) -> bool;
+
+    // One rebalancing decision from the load seen since the previous call. True if a worker was asked to shed.
+    // Runs on worker 0 every policy interval when runtime_options::rebalance is set, can be called by hand too.
+    auto rebalance(const rebalance_policy &policy) -> bool;
+    // Call after setup has run on every worker, it reads their contexts.
+    [[nodiscard]] auto placement() const -> numa_report;
+
+private:
+    void run_worker(worker &w, const setup_fn &setup);
+
+    std::mutex rebalance_mtx;
+    std::vector<std::uint64_t> last_completions;
+
+    std::vector<Tcp_socket> inherited;
+    mutable std::mutex listener_mtx;  // Worker exit closes its listener while handoff_entries() may be reading them
+    std::atomic<std::int64_t> drain_deadline{0};  // steady_clock ticks, 0 when not draining
+};
+
+auto pin_to_cpu(int cpu) -> result<void>
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (int rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set); rc != 0)
+        return std::unexpected(Err{rc, std::format("Failed to pin thread to cpu {}", cpu)});
+    return {};
+}
+
+// Node a worker on `cpu` should allocate from, -1 for "leave placement alone" (option off or single node).
+auto worker_node(bool numa_local, int cpu) -> int
+{
+    return numa_local && numa::node_count() > 1 ? numa::node_of_cpu(cpu) : -1;
+}
+
+// On the worker's thread, after pinning: from here on its first touches land on `node`. Returns the errno, 0 on success.
+auto prefer_worker_node(int node) -> int
+{
+    if (node < 0)
+        return 0;
+    auto res = numa::prefer_node(node);
+    return res ? 0 : res.error().code.value();
+}
+
+auto runtime::start(setup_fn setup) -> result<void>
+{
+    if (!threads.empty())
+        return std::unexpected(Err::app(std::errc::operation_in_progress, "Runtime already started"));
+
+    const std::size_t n = std::max<std::size_t>(opts.workers, 1);
+    stopping = false;
+    drain_deadline = 0;
+    workers.clear();
+
+    std::vector<int> cpus(n);
+    for (std::size_t i = 0; i < n; ++i) cpus[i] = i < opts.cpus.size() ? opts.cpus[i] : static_cast<int>(i);
+
+    // Listeners are opened in worker order, that order is the socket's index in the reuseport group.
+    std::optional<listener_group> group;
+    if (!inherited.empty())
+    {
+        if (inherited.size() != n)
+            return std::unexpected(Err::app(std::errc::invalid_argument,
+                std::format("Inherited {} listeners for {} workers, the reuseport group order would not match", inherited.size(), n)));
+        group.emplace(listener_group{.listeners = std::move(inherited), .cpus = cpus});
+        inherited.clear();
+    }
+    else if (opts.listen)
+    {
+        auto g = listener_group::open(*opts.listen, {.cpus = cpus, .options = opts.listen_options, .backlog = opts.backlog, .steer = opts.steer_by_cpu});
+        if (!g)
+            return std::unexpected(g.error());
+        group.emplace(std::move(*g));
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto w = std::make_unique<worker>(i, cpus[i], *this);
+        w->node = worker_node(opts.numa_local, cpus[i]);
+        if (group)
+            w->listener.emplace(group->take(i));
+        workers.push_back(std::move(w));
+    }
+
+    threads.reserve(n);
+    for (auto &w : workers) threads.emplace_back([this, &wk = *w, setup] { run_worker(wk, setup); });
+
+    return {};
+}
+
+void runtime::run_worker(worker &w, const setup_fn &setup)
+{
+    // Not fatal: the worker still runs, stats() shows where it could not be placed.
+    if (auto res = pin_to_cpu(w.cpu); !res)
+        w.stats.pin_error.store(res.error().code.value(), std::memory_order_relaxed);
+    w.stats.numa_error.store(prefer_worker_node(w.node), std::memory_order_relaxed);
+    w.ctx.emplace(opts.ring_entries, w.node);
+
+    w.running.store(true, std::memory_order_release);
+    if (setup)
+        setup(w);
+
+    auto &ctx = *w.ctx;
+    const bool rebalancer = opts.rebalance && w.id == 0;
+    auto next_rebalance = std::chrono::steady_clock::now() + (rebalancer ? opts.rebalance->interval : std::chrono::milliseconds{0});
+
+    bool drain_seen = false;
+    while (!stopping.load(std::memory_order_acquire))
+    {
+        if (auto deadline = drain_deadline.load(std::memory_order_acquire); deadline != 0)
+        {
+            if (!drain_seen && w.listener)
+                w.spawn(fut::cancel_fd(ctx, w.listener->fd.native_handle()));
+            drain_seen = true;
+            if (w.tasks.empty() || std::chrono::steady_clock::now().time_since_epoch().count() >= deadline)
+                break;
+        }
+
+        if (rebalancer && std::chrono::steady_clock::now() >= next_rebalance)
+        {
+            rebalance(*opts.rebalance);
+            next_rebalance += opts.rebalance->interval;
+        }
+
+        w.poll_tasks();
+
+        auto done = ctx.poll_for(opts.tick);
+        w.stats.completions.fetch_add(done, std::memory_order_relaxed);
+        w.stats.loops.fetch_add(1, std::memory_order_relaxed);
+
+        ctx.purge_graveyard();
+    }
+
+    // No migration is posted here after this, and the ones already posted see running == false and go back.
+    {
+        std::lock_guard lock(w.migrate_mtx);
+        w.running.store(false, std::memory_order_release);
+    }
+    if (!ctx.mailbox->empty())
+        ctx.mailbox->drain();
+
+    // Requests in flight point into the tasks and their buffers: cancel them and take their completions while
+    // the tasks are alive, then drop the tasks, all before the context goes.
+    ctx.quiesce();
+    w.tasks.clear();
+    {
+        std::lock_guard lock(listener_mtx);
+        w.listener.reset();
+    }
+    w.stats.live.store(0, std::memory_order_relaxed);
+}
+
+auto runtime::stats() const -> std::vector<worker_snapshot>
+{
+    std::vector<worker_snapshot> out;
+    out.reserve(workers.size());
+    for (const auto &w : workers)
+    {
+        constexpr auto r = std::memory_order_relaxed;
+        out.push_back({
+            .id = w->id,
+            .cpu = w->cpu,
+            .node = w->node,
+            .loops = w->stats.loops.load(r),
+            .completions = w->stats.completions.load(r),
+            .spawned = w->stats.spawned.load(r),
+            .finished = w->stats.finished.load(r),
+            .failed = w->stats.failed.load(r),
+            .live = w->stats.live.load(r),
+            .migrated_in = w->stats.migrated_in.load(r),
+            .migrated_out = w->stats.migrated_out.load(r),
+            .pin_error = w->stats.pin_error.load(r),
+            .numa_error = w->stats.numa_error.load(r),
+        });
+    }
+    return out;
+}
+
+template <typename Session, typename Adopt>
+requires std::invocable<Adopt &, worker &, Tcp_socket, Session>
+auto runtime::migrate(worker &from, std::size_t to, Tcp_socket sock, Session session, Adopt adopt) -> bool
+{
+    if (to >= workers.size() || workers[to].get() == &from)
+    {
+        adopt(from, std::move(sock), std::move(session));
+        return to < workers.size();
+    }
+
+    // An inbox nobody drains any more would only hold the connection until the context goes, keep it here.
+    auto &target = *workers[to];
+    std::unique_lock lock(target.migrate_mtx);
+    if (!target.running.load(std::memory_order_acquire))
+    {
+        lock.unlock();
+        adopt(from, std::move(sock), std::move(session));
+        return false;
+    }
+
+    from.stats.migrated_out.fetch_add(1, std::memory_order_relaxed);
+    // The fd is process wide, only ring state is per context, and the caller made sure none is left.
+    target.ctx->post([this, &from, &target, sock = std::move(sock), session = std::move(session), adopt = std::move(adopt)]() mutable {
+        // Run by the target's exit drain: it stopped after accepting the post, send the connection back.
+        if (!target.running.load(std::memory_order_acquire))
+        {
+            migrate(target, from.id, std::move(sock), std::move(session), std::move(adopt));
+            return;
+        }
+        target.stats.migrated_in.fetch_add(1, std::memory_order_relaxed);
+        adopt(target, std::move(sock), std::move(session));
+    });
+    return true;
+}
+
+auto runtime::rebalance(const rebalance_policy &policy) -> bool
+{
+    std::lock_guard lock(rebalance_mtx);
+    last_completions.resize(workers.size(), 0);
+
+    std::size_t hot = 0, cold = 0;
+    std::uint64_t hot_load = 0, cold_load = std::numeric_limits<std::uint64_t>::max();
+    for (std::size_t i = 0; i < workers.size(); ++i)
+    {
+        auto now = workers[i]->stats.completions.load(std::memory_order_relaxed);
+        auto load = now - std::exchange(last_completions[i], now);
+        if (load >= hot_load)
+            hot = i, hot_load = load;
+        if (load < cold_load)
+            cold = i, cold_load = load;
+    }
+
+    if (hot == cold || hot_load < policy.min_load)
+        return false;
+    if (static_cast<double>(hot_load) < policy.skew * static_cast<double>(std::max<std::uint64_t>(cold_load, 1)))
+        return false;
+
+    // Previous decision still being worked off.
+    auto &w = *workers[hot];
+    if (w.shed_quota.load(std::memory_order_acquire) != 0)
+        return false;
+
+    w.shed_to.store(cold, std::memory_order_relaxed);
+    w.shed_quota.store(policy.max_moves, std::memory_order_release);
+    return true;
+}
+
+auto runtime::adopt_listeners(std::vector<Tcp_socket> socks) -> result<void>
+{
+    if (!threads.empty())
+        return std::unexpected(Err::app(std::errc::operation_in_progress, "Listeners must be adopted before start()"));
+    inherited = std::move(socks);
+    return {};
+}
+
+auto runtime::handoff_entries() const -> std::vector<handoff_entry>
+{
+    std::vector<handoff_entry> out;
+    std::lock_guard lock(listener_mtx);
+    for (const auto &w : workers)
+        if (w->listener)
+            out.push_back({.name = std::format("listener.{}", w->id), .kind = handoff_kind::listener, .fd = w->listener->fd.native_handle()});
+    return out;
+}
+
+void runtime::drain(std::chrono::milliseconds grace)
+{
+    auto deadline = std::chrono::steady_clock::now() + grace;
+    drain_deadline.store(std::max<std::int64_t>(deadline.time_since_epoch().count(), 1), std::memory_order_release);
+}
+
+auto runtime::placement() const -> numa_report
+{
+    numa_report out{.workers = {}};
+    for (const auto &w : workers)
+        if (w->ctx)
+            out.workers.push_back({.id = w->id, .cpu = w->cpu, .node = w->node, .ring = w->ctx->ring_placement()});
+    return out;
+}
+
+}  // namespace rio
@@ -3,3 +3,7 @@ module;
 export module rio:socket;
 export import :socket.tcp_socket;
 export import :socket.address;
+export import :socket.listener_group;
+export import :socket.unix_socket;
+export import :socket.handoff;
+export import :socket.udp_socket;
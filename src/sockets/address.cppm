@@ -2,6 +2,8 @@ module;
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
+#include <cstddef>
 #include <cerrno>
 
 export module rio:socket.address;
@@ -18,6 +20,7 @@ export struct address
         sockaddr general;
         sockaddr_in v4;
         sockaddr_in6 v6;
+        sockaddr_un un;
         sockaddr_storage any;
 
         storage_t() : any{} {}
@@ -109,6 +112,41 @@ export struct address
         return addr;
     }
 
+    // --- Unix domain ---
+
+    // Filesystem path. `@name` is taken as an abstract address, like ss/netstat print them.
+    [[nodiscard]]
+    static auto from_unix(std::string_view path) -> result<address>
+    {
+        if (path.starts_with('@'))
+            return from_abstract(path.substr(1));
+
+        address addr;
+        addr.storage.un.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.storage.un.sun_path)) [[unlikely]]
+            return std::unexpected(Err{EINVAL, std::format("Invalid unix socket path: '{}'", path)});
+
+        std::memcpy(addr.storage.un.sun_path, path.data(), path.size());
+        addr.storage.un.sun_path[path.size()] = '\0';
+        addr.len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+        return addr;
+    }
+
+    // Abstract namespace (Linux): no file, gone with the last socket, the name may hold any bytes.
+    [[nodiscard]]
+    static auto from_abstract(std::string_view name) -> result<address>
+    {
+        address addr;
+        addr.storage.un.sun_family = AF_UNIX;
+        if (name.size() + 1 > sizeof(addr.storage.un.sun_path)) [[unlikely]]
+            return std::unexpected(Err{EINVAL, std::format("Abstract unix socket name too long: '{}'", name)});
+
+        addr.storage.un.sun_path[0] = '\0';
+        std::memcpy(addr.storage.un.sun_path + 1, name.data(), name.size());
+        addr.len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+        return addr;
+    }
+
     // --- Auto-detect IP version ---
 
     [[nodiscard]]
@@ -164,6 +202,18 @@ export struct address
         return storage.general.sa_family == AF_INET6;
     }
 
+    [[nodiscard]]
+    auto is_unix() const -> bool
+    {
+        return storage.general.sa_family == AF_UNIX;
+    }
+
+    [[nodiscard]]
+    auto is_abstract() const -> bool
+    {
+        return is_unix() && len > offsetof(sockaddr_un, sun_path) && storage.un.sun_path[0] == '\0';
+    }
+
     [[nodiscard]]
     auto port() const -> uint16_t
     {
@@ -195,6 +245,18 @@ export struct address
             return std::format("[{}]:{}", buf, ntohs(storage.v6.sin6_port));
         }
 
+        if (is_unix())
+        {
+            // Unnamed (socketpair, unbound client): nothing after the family.
+            if (len <= offsetof(sockaddr_un, sun_path))
+                return "unix:unnamed";
+            std::size_t n = len - offsetof(sockaddr_un, sun_path);
+            if (is_abstract())
+                return std::format("@{}", std::string_view(storage.un.sun_path + 1, n - 1));
+            std::string_view path(storage.un.sun_path, n);
+            return std::string(path.substr(0, path.find('\0')));
+        }
+
         return "unknown";
     }
 
@@ -0,0 +1,252 @@
+module;
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+
+export module rio:socket.handoff;
+import :socket.address;
+import :socket.tcp_socket;
+import :socket.unix_socket;
+import :handle;
+import :utils;
+
+import std;
+
+namespace rio {
+
+// Socket handoff between an old and a new server process, for restarts without refused connections.
+// The old process exposes a SOCK_SEQPACKET unix socket, the successor connects, receives every listener
+// (and any idle connections the old side chose to pass) through SCM_RIGHTS and acks once it owns them.
+// Both processes then hold the same sockets: the accept queue and the reuseport group carry over, and
+// the old process just stops accepting and drains.
+
+export enum class handoff_kind : std::uint8_t
+{
+    listener = 1,
+    connection = 2,
+};
+
+// Old side: what to pass. `fd` is borrowed, the successor gets its own copy and the old one stays open.
+export struct handoff_entry
+{
+    std::string name;  // At most 255 bytes, how the successor finds it again ("http", "listener.3", ...)
+    handoff_kind kind = handoff_kind::listener;
+    int fd = -1;
+};
+
+export struct inherited_socket
+{
+    std::string name;
+    handoff_kind kind;
+    rio::Tcp_socket sock;
+};
+
+// New side: everything the predecessor passed, in the order it was sent.
+export struct handoff_set
+{
+    std::vector<inherited_socket> sockets;
+
+    // Moves out the first socket with this name.
+    auto take(std::string_view name) -> std::optional<rio::Tcp_socket>
+    {
+        for (auto &s : sockets)
+            if (s.name == name && s.sock)
+                return std::move(s.sock);
+        return std::nullopt;
+    }
+
+    // Moves out every listener, in sent order (which is the reuseport group order for runtime listeners).
+    auto take_listeners() -> std::vector<rio::Tcp_socket>
+    {
+        std::vector<rio::Tcp_socket> out;
+        for (auto &s : sockets)
+            if (s.kind == handoff_kind::listener && s.sock)
+                out.push_back(std::move(s.sock));
+        return out;
+    }
+};
+
+namespace internals {
+
+// Packet: magic, entry count, last-packet flag, then per entry {kind, name length, name}. fds ride along in order.
+constexpr std::uint32_t handoff_magic = 0x52494f48;  // "RIOH"
+constexpr std::uint8_t handoff_ack = 'A';
+constexpr std::size_t handoff_packet_max = 8 + max_passed_fds * (2 + 255);
+
+template <typename T>
+void put(std::string &out, T v)
+{
+    char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));
+    out.append(b, sizeof(T));
+}
+
+template <typename T>
+auto get(std::span<const char> &in) -> std::optional<T>
+{
+    if (in.size() < sizeof(T))
+        return std::nullopt;
+    T v;
+    std::memcpy(&v, in.data(), sizeof(T));
+    in = in.subspan(sizeof(T));
+    return v;
+}
+
+// Only a process of the same user may take our sockets.
+inline auto check_peer(const Unix_socket &s) -> result<void>
+{
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    if (::getsockopt(s.fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+        return std::unexpected(Err::sys("Failed to read handoff peer credentials"));
+    if (cred.uid != ::geteuid())
+        return std::unexpected(Err::app(std::errc::permission_denied, std::format("Handoff peer runs as uid {}", cred.uid)));
+    return {};
+}
+
+inline auto set_timeout(const Unix_socket &s, std::chrono::milliseconds t) -> result<void>
+{
+    auto sec = std::chrono::duration_cast<std::chrono::seconds>(t);
+    timeval tv{.tv_sec = static_cast<time_t>(sec.count()), .tv_usec = static_cast<suseconds_t>((t - sec).count() * 1000)};
+    if (::setsockopt(s.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1 || ::setsockopt(s.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == -1)
+        return std::unexpected(Err::sys("Failed to set handoff timeout"));
+    return {};
+}
+
+inline auto is_listening(int fd) -> bool
+{
+    int v = 0;
+    socklen_t len = sizeof(v);
+    return ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &v, &len) == 0 && v;
+}
+
+}  // namespace internals
+
+// Old process side. Open it at startup, call serve() when a successor is due.
+export struct handoff_server
+{
+    Unix_socket sock;
+
+    static auto open(const rio::address &at) -> result<handoff_server>
+    {
+        auto s = Unix_socket::open(at, unix_type::seqpacket);
+        if (!s)
+            return std::unexpected(s.error());
+        if (auto l = rio::listen(*s, 1); !l)
+            return std::unexpected(l.error());
+        return handoff_server{std::move(*s)};
+    }
+
+    // Waits for one successor, sends it `entries` and returns once it acked. On error nothing changed for
+    // this process, it keeps serving. `timeout` bounds each exchange after the successor connected.
+    auto serve(std::span<const handoff_entry> entries, std::chrono::milliseconds timeout = std::chrono::seconds{10}) -> result<void>;
+};
+
+auto handoff_server::serve(std::span<const handoff_entry> entries, std::chrono::milliseconds timeout) -> result<void>
+{
+    for (const auto &e : entries)
+        if (e.name.size() > 255 || e.fd < 0)
+            return std::unexpected(Err::app(std::errc::invalid_argument, std::format("Bad handoff entry '{}'", e.name)));
+
+    auto acc = rio::accept(sock);
+    if (!acc)
+        return std::unexpected(acc.error());
+    auto &peer = std::get<0>(*acc);
+
+    if (auto r = internals::check_peer(peer); !r)
+        return std::unexpected(r.error());
+    if (auto r = internals::set_timeout(peer, timeout); !r)
+        return std::unexpected(r.error());
+
+    // One packet per max_passed_fds entries, an empty list still sends the final packet.
+    std::size_t at = 0;
+    do
+    {
+        auto batch = entries.subspan(at, std::min(max_passed_fds, entries.size() - at));
+        at += batch.size();
+
+        std::string pkt;
+        internals::put(pkt, internals::handoff_magic);
+        internals::put(pkt, static_cast<std::uint16_t>(batch.size()));
+        internals::put(pkt, static_cast<std::uint16_t>(at == entries.size()));
+
+        std::vector<int> fds;
+        fds.reserve(batch.size());
+        for (const auto &e : batch)
+        {
+            internals::put(pkt, static_cast<std::uint8_t>(e.kind));
+            internals::put(pkt, static_cast<std::uint8_t>(e.name.size()));
+            pkt.append(e.name);
+            fds.push_back(e.fd);
+        }
+
+        if (auto r = send_fds(peer, pkt, fds); !r)
+            return std::unexpected(r.error());
+    } while (at < entries.size());
+
+    char ack = 0;
+    ssize_t n = ::recv(peer.fd, &ack, 1, 0);
+    if (n == -1)
+        return std::unexpected(Err::sys("No handoff ack from successor"));
+    if (n != 1 || ack != internals::handoff_ack)
+        return std::unexpected(Err::app(std::errc::connection_aborted, "Successor dropped the handoff"));
+    return {};
+}
+
+// New process side: connects to the predecessor at `from`, adopts every socket it passes and acks.
+export auto receive_handoff(const rio::address &from, std::chrono::milliseconds timeout = std::chrono::seconds{10}) -> result<handoff_set>
+{
+    auto peer = Unix_socket::connect(from, unix_type::seqpacket);
+    if (!peer)
+        return std::unexpected(peer.error());
+    if (auto r = internals::check_peer(*peer); !r)
+        return std::unexpected(r.error());
+    if (auto r = internals::set_timeout(*peer, timeout); !r)
+        return std::unexpected(r.error());
+
+    handoff_set set;
+    std::vector<char> buf(internals::handoff_packet_max);
+    bool last = false;
+    while (!last)
+    {
+        auto msg = recv_fds(*peer, buf);
+        if (!msg)
+            return std::unexpected(msg.error());
+        if (msg->bytes == 0)
+            return std::unexpected(Err::app(std::errc::connection_aborted, "Predecessor closed the handoff early"));
+
+        std::span<const char> in(buf.data(), msg->bytes);
+        auto magic = internals::get<std::uint32_t>(in);
+        auto count = internals::get<std::uint16_t>(in);
+        auto flags = internals::get<std::uint16_t>(in);
+        if (magic != internals::handoff_magic || !count || !flags || *count != msg->fds.size())
+            return std::unexpected(Err::app(std::errc::bad_message, "Malformed handoff packet"));
+        last = *flags & 1;
+
+        for (auto &fd : msg->fds)
+        {
+            auto kind = internals::get<std::uint8_t>(in);
+            auto len = internals::get<std::uint8_t>(in);
+            if (!kind || !len || in.size() < *len)
+                return std::unexpected(Err::app(std::errc::bad_message, "Malformed handoff entry"));
+
+            std::string name(in.data(), *len);
+            in = in.subspan(*len);
+
+            auto k = static_cast<handoff_kind>(*kind);
+            if ((k == handoff_kind::listener) != internals::is_listening(fd))
+                return std::unexpected(Err::app(std::errc::bad_message, std::format("Handoff entry '{}' is not a {}", name, k == handoff_kind::listener ? "listener" : "connection")));
+
+            set.sockets.push_back({.name = std::move(name), .kind = k, .sock = rio::Tcp_socket{std::move(fd)}});
+        }
+    }
+
+    // The ack is the point of no return for the predecessor: it stops accepting once this arrives.
+    if (::send(peer->fd, &internals::handoff_ack, 1, MSG_NOSIGNAL) != 1)
+        return std::unexpected(Err::sys("Failed to ack handoff"));
+    return set;
+}
+
+}  // namespace rio
@@ -0,0 +1,103 @@
+module;
+
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <cerrno>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+
+export module rio:socket.listener_group;
+import :socket.address;
+import :socket.tcp_socket;
+import :handle;
+import :utils;
+
+import std;
+
+namespace rio {
+
+export struct listener_group_options
+{
+    std::vector<int> cpus{};  // cpus[i]: cpu serving listener i. One listener per entry.
+    s_opt options = s_opt::async_server_v4;
+    int backlog = 1024;
+    bool steer = true;  // Attach the cpu -> listener BPF program, without it the kernel hashes flows over the group
+};
+
+// Classic BPF reuseport selector: returns the index of the listener whose cpu took the SYN, cpu % n for
+// cpus outside the list. The cpu is the one running the softirq, so RSS / IRQ affinity has to put each
+// queue on the core whose worker owns the matching listener for steering to pay off.
+auto steering_program(std::span<const int> cpus) -> std::vector<sock_filter>
+{
+    std::vector<sock_filter> prog;
+    prog.reserve(cpus.size() * 2 + 3);
+
+    prog.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<std::uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for (std::size_t i = 0; i < cpus.size(); ++i)
+    {
+        // A == cpus[i] ? return i : next pair
+        prog.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<std::uint32_t>(cpus[i]), 0, 1));
+        prog.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<std::uint32_t>(i)));
+    }
+    prog.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<std::uint32_t>(cpus.size())));
+    prog.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+    return prog;
+}
+
+// One SO_REUSEPORT listener per worker, bound in order so listener i is index i of the kernel's group,
+// and steered so that a connection is accepted by the listener of the cpu that received it.
+// Each listener also carries SO_INCOMING_CPU, which the kernel uses to pick within the group when no
+// program is attached (and to keep the accept path local).
+export struct listener_group
+{
+    std::vector<Tcp_socket> listeners;
+    std::vector<int> cpus;
+
+    static auto open(const rio::address &addr, listener_group_options opts) -> result<listener_group>;
+
+    [[nodiscard]] auto size() const -> std::size_t { return listeners.size(); }
+    auto operator[](std::size_t i) -> Tcp_socket & { return listeners[i]; }
+
+    // Hands listener i to its worker. The group keeps its slot, closing it would shift later indices.
+    auto take(std::size_t i) -> Tcp_socket { return std::move(listeners[i]); }
+};
+
+auto listener_group::open(const rio::address &addr, listener_group_options opts) -> result<listener_group>
+{
+    if (opts.cpus.empty())
+        return std::unexpected(Err::app(std::errc::invalid_argument, "listener_group needs at least one cpu"));
+
+    listener_group g;
+    g.cpus = std::move(opts.cpus);
+    g.listeners.reserve(g.cpus.size());
+
+    for (int cpu : g.cpus)
+    {
+        auto l = Tcp_socket::open_and_listen(addr, opts.options | s_opt::reuse, opts.backlog);
+        if (!l)
+            return std::unexpected(l.error());
+
+        if (::setsockopt(l->fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == -1)
+            return std::unexpected(Err::sys(std::format("Failed to set SO_INCOMING_CPU={}", cpu)));
+
+        g.listeners.push_back(std::move(*l));
+    }
+
+    if (opts.steer)
+    {
+        auto prog = steering_program(g.cpus);
+        sock_fprog fprog{.len = static_cast<unsigned short>(prog.size()), .filter = prog.data()};
+        // The program belongs to the group, attaching it through any member is enough.
+        if (::setsockopt(g.listeners.front().fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &fprog, sizeof(fprog)) == -1)
+            return std::unexpected(Err::sys("Failed to attach reuseport steering program"));
+    }
+
+    return g;
+}
+
+}  // namespace rio
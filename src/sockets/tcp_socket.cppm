@@ -155,6 +155,30 @@ export auto listen(Tcp_socket &s, int backlog = 128) -> result<void>
     return {};
 }
 
+// Blocking connect, or operation_in_progress on a non-blocking socket (completion shows up as writability).
+export auto connect(Tcp_socket &s, const address &addr) -> result<void>
+{
+    if (::connect(s.fd, &addr.storage.general, addr.len) == -1) [[unlikely]]
+    {
+        if (errno == EINPROGRESS)
+            return std::unexpected(Err::app(std::errc::operation_in_progress, "Connect in progress"));
+        return std::unexpected(Err{errno, std::format("Failed to connect to '{}'", addr)});
+    }
+    return {};
+}
+
+namespace internals {
+
+// Client socket for `addr`: the family follows the address, whatever v4/v6/dualstack `options` asked for.
+inline auto client_socket(const address &addr, s_opt options) -> result<Tcp_socket>
+{
+    constexpr auto family = static_cast<std::uint32_t>(s_opt::v4 | s_opt::v6 | s_opt::dualstack);
+    auto rest = static_cast<s_opt>(static_cast<std::uint32_t>(options) & ~family);
+    return Tcp_socket::open(rest | (addr.is_ipv6() ? s_opt::v6 : s_opt::v4));
+}
+
+}  // namespace internals
+
 export auto accept(Tcp_socket &s, s_opt options = s_opt::none) -> result<std::tuple<Tcp_socket, address>>
 {
     const int flags = SOCK_CLOEXEC | (has(options, s_opt::nonblock) ? SOCK_NONBLOCK : 0);
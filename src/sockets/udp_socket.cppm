@@ -0,0 +1,334 @@
+module;
+
+#include <liburing.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+#include <cerrno>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+export module rio:socket.udp_socket;
+import :socket.address;
+import :socket.tcp_socket;
+import :handle;
+import :utils;
+
+import std;
+
+namespace rio {
+
+// Of the s_opt flags v4/v6/dualstack, nonblock, cloexec and reuse apply.
+export struct Udp_socket
+{
+    rio::handle fd{};
+
+    Udp_socket() = default;
+    explicit Udp_socket(rio::handle &&h) : fd(std::move(h)) {}
+
+    static auto open(s_opt options = s_opt::v4 | s_opt::cloexec) -> result<Udp_socket>;
+    static auto open(const rio::address &address, s_opt options = s_opt::v4 | s_opt::cloexec) -> result<Udp_socket>;
+
+    static auto attach(int raw_fd) -> Udp_socket;
+    explicit operator bool() const;
+};
+
+auto Udp_socket::open(s_opt options) -> result<Udp_socket>
+{
+    if (has(options, s_opt::v4) && has(options, s_opt::v6))
+        return std::unexpected(Err{EINVAL, "Cannot specify both IPv4 and IPv6"});
+
+    const int domain = (has(options, s_opt::v6) || has(options, s_opt::dualstack)) ? AF_INET6 : AF_INET;
+    int type = SOCK_DGRAM;
+    if (has(options, s_opt::cloexec))
+        type |= SOCK_CLOEXEC;
+    if (has(options, s_opt::nonblock))
+        type |= SOCK_NONBLOCK;
+
+    const int s = ::socket(domain, type, 0);
+    if (s == -1)
+        return std::unexpected(Err{errno, "Failed to create UDP socket"});
+    auto sock = Udp_socket::attach(s);
+
+    const int one = 1, zero = 0;
+    if (has(options, s_opt::reuse))
+        if (::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 || ::setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1)
+            return std::unexpected(Err::sys("Failed to set SO_REUSEADDR/SO_REUSEPORT"));
+
+    if (domain == AF_INET6)
+        if (::setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, has(options, s_opt::dualstack) ? &zero : &one, sizeof(int)) == -1)
+            return std::unexpected(Err::sys("Failed to set IPV6_V6ONLY"));
+
+    return sock;
+}
+
+auto Udp_socket::attach(int raw_fd) -> Udp_socket { return Udp_socket{rio::handle(raw_fd)}; }
+
+Udp_socket::operator bool() const { return static_cast<bool>(fd); }
+
+export auto bind(Udp_socket &s, const address &addr) -> result<void>
+{
+    if (::bind(s.fd, &addr.storage.general, addr.len) == -1) [[unlikely]]
+        return std::unexpected(Err{errno, std::format("Failed to bind UDP socket to '{}'", addr)});
+    return {};
+}
+
+auto Udp_socket::open(const rio::address &address, s_opt options) -> result<Udp_socket>
+{
+    auto o_res = open(options);
+    if (!o_res) [[unlikely]]
+        return std::unexpected(o_res.error());
+
+    if (auto res = bind(*o_res, address); !res) [[unlikely]]
+        return std::unexpected(res.error());
+
+    return o_res;
+}
+
+// Sets the default peer, sends may then pass no address and only its datagrams are received.
+export auto connect(Udp_socket &s, const address &addr) -> result<void>
+{
+    if (::connect(s.fd, &addr.storage.general, addr.len) == -1) [[unlikely]]
+        return std::unexpected(Err{errno, std::format("Failed to connect UDP socket to '{}'", addr)});
+    return {};
+}
+
+// UDP_GRO: the kernel coalesces consecutive datagrams of one flow into a single receive,
+// the segment size comes back with each message (udp_batch::segment / udp_message::segment).
+export auto set_gro(Udp_socket &s, bool on = true) -> result<void>
+{
+    const int v = on;
+    if (::setsockopt(s.fd, SOL_UDP, UDP_GRO, &v, sizeof(v)) == -1)
+        return std::unexpected(Err::sys("Failed to set UDP_GRO"));
+    return {};
+}
+
+// UDP_SEGMENT default for the socket: every send larger than `segment` is cut into datagrams of that size
+// by the stack (or the NIC). 0 turns it off. A per-send gso_size in udp_out overrides it.
+export auto set_gso(Udp_socket &s, std::uint16_t segment) -> result<void>
+{
+    const int v = segment;
+    if (::setsockopt(s.fd, SOL_UDP, UDP_SEGMENT, &v, sizeof(v)) == -1)
+        return std::unexpected(Err::sys("Failed to set UDP_SEGMENT"));
+    return {};
+}
+
+namespace internals {
+
+// Room for one UDP_GRO / UDP_SEGMENT control message.
+struct udp_cmsg
+{
+    alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(int))];
+};
+
+inline auto gro_segment(const msghdr &msg) -> std::uint16_t
+{
+    for (cmsghdr *c = CMSG_FIRSTHDR(const_cast<msghdr *>(&msg)); c; c = CMSG_NXTHDR(const_cast<msghdr *>(&msg), c))
+        if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO)
+        {
+            int v;
+            std::memcpy(&v, CMSG_DATA(c), sizeof(v));
+            return static_cast<std::uint16_t>(v);
+        }
+    return 0;
+}
+
+}  // namespace internals
+
+// One receive of a ring multishot recvmsg (as::recv_multishot). `payload` points into a provided buffer
+// that goes back to the kernel when the callback returns.
+export struct udp_message
+{
+    std::span<const char> payload;
+    rio::address peer;
+    std::uint16_t segment = 0;  // GRO segment size, 0 for a single datagram
+    bool truncated = false;
+};
+
+namespace internals {
+
+// Multishot recvmsg writes an io_uring_recvmsg_out header, the name and the control data ahead of the payload,
+// sized after `tmpl`'s msg_namelen / msg_controllen.
+inline auto parse_multishot(std::span<char> buf, int res, msghdr &tmpl) -> std::optional<udp_message>
+{
+    auto *out = io_uring_recvmsg_validate(buf.data(), res, &tmpl);
+    if (!out)
+        return std::nullopt;
+
+    udp_message m;
+    m.peer.len = std::min<socklen_t>(out->namelen, tmpl.msg_namelen);
+    std::memcpy(&m.peer.storage, io_uring_recvmsg_name(out), m.peer.len);
+    m.payload = {static_cast<const char *>(io_uring_recvmsg_payload(out, &tmpl)), io_uring_recvmsg_payload_length(out, res, &tmpl)};
+    m.truncated = out->flags & MSG_TRUNC;
+    for (cmsghdr *c = io_uring_recvmsg_cmsg_firsthdr(out, &tmpl); c; c = io_uring_recvmsg_cmsg_nexthdr(out, &tmpl, c))
+        if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO)
+        {
+            int v;
+            std::memcpy(&v, CMSG_DATA(c), sizeof(v));
+            m.segment = static_cast<std::uint16_t>(v);
+        }
+    return m;
+}
+
+}  // namespace internals
+
+// Receive side of recv_batch: `slots` datagram buffers of `slot_size` bytes in one allocation, reused per call.
+// With GRO a slot holds several coalesced datagrams, size slots for it (up to 64 KiB).
+export struct udp_batch
+{
+    std::size_t slot_size;
+    std::vector<char> storage;
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iov;
+    std::vector<rio::address> peers;
+    std::vector<internals::udp_cmsg> ctl;
+    std::size_t count = 0;  // Slots filled by the last recv_batch
+
+    explicit udp_batch(std::size_t slots = 64, std::size_t slot_size = 2048)
+        : slot_size(slot_size), storage(slots * slot_size), msgs(slots), iov(slots), peers(slots), ctl(slots)
+    {
+        for (std::size_t i = 0; i < slots; ++i)
+            iov[i] = {.iov_base = storage.data() + i * slot_size, .iov_len = slot_size};
+    }
+
+    [[nodiscard]] auto capacity() const -> std::size_t { return msgs.size(); }
+    [[nodiscard]] auto size() const -> std::size_t { return count; }
+
+    [[nodiscard]] auto payload(std::size_t i) const -> std::span<const char> { return {storage.data() + i * slot_size, msgs[i].msg_len}; }
+    [[nodiscard]] auto peer(std::size_t i) const -> const rio::address & { return peers[i]; }
+    // GRO segment size of slot i, 0 when it holds a single datagram.
+    [[nodiscard]] auto segment(std::size_t i) const -> std::uint16_t { return internals::gro_segment(msgs[i].msg_hdr); }
+    [[nodiscard]] auto truncated(std::size_t i) const -> bool { return msgs[i].msg_hdr.msg_flags & MSG_TRUNC; }
+
+    // Calls fn(span<const char> datagram, const address &peer) for every datagram, GRO slots split back up.
+    template <typename Fn>
+    void for_each(Fn &&fn) const
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto data = payload(i);
+            const std::size_t seg = segment(i);
+            if (!seg)
+            {
+                fn(data, peers[i]);
+                continue;
+            }
+            for (std::size_t at = 0; at < data.size(); at += seg)
+                fn(data.subspan(at, std::min(seg, data.size() - at)), peers[i]);
+        }
+    }
+
+    // Resets the headers recvmmsg overwrote, called by recv_batch.
+    void prepare()
+    {
+        for (std::size_t i = 0; i < msgs.size(); ++i)
+        {
+            auto &h = msgs[i].msg_hdr;
+            h = {};
+            h.msg_name = &peers[i].storage;
+            h.msg_namelen = sizeof(peers[i].storage);
+            h.msg_iov = &iov[i];
+            h.msg_iovlen = 1;
+            h.msg_control = ctl[i].buf;
+            h.msg_controllen = sizeof(ctl[i].buf);
+            msgs[i].msg_len = 0;
+        }
+    }
+};
+
+// One recvmmsg: fills up to batch.capacity() slots, returns how many. Nothing pending on a non-blocking
+// socket (or with MSG_DONTWAIT) is operation_would_block.
+export auto recv_batch(Udp_socket &s, udp_batch &batch, int flags = 0) -> result<std::size_t>
+{
+    batch.prepare();
+    batch.count = 0;
+
+    const int n = ::recvmmsg(s.fd, batch.msgs.data(), static_cast<unsigned>(batch.msgs.size()), flags, nullptr);
+    if (n == -1) [[unlikely]]
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return std::unexpected(Err::app(std::errc::operation_would_block, "Would block/No pending datagrams"));
+        return std::unexpected(Err{errno, "recvmmsg failed"});
+    }
+
+    batch.count = static_cast<std::size_t>(n);
+    for (std::size_t i = 0; i < batch.count; ++i) batch.peers[i].len = batch.msgs[i].msg_hdr.msg_namelen;
+    return batch.count;
+}
+
+// One datagram to send. With gso_size set, `data` is a run of datagrams of that size (the last may be shorter)
+// that leaves as one send and is split by the stack or the NIC.
+export struct udp_out
+{
+    std::span<const char> data;
+    const rio::address *to = nullptr;  // nullptr on connected sockets
+    std::uint16_t gso_size = 0;
+};
+
+// sendmmsg in chunks of 64 messages. Returns how many were sent, fewer than out.size() when the socket
+// would block part way (an error only if not even the first one went out).
+export auto send_batch(Udp_socket &s, std::span<const udp_out> out, int flags = 0) -> result<std::size_t>
+{
+    constexpr std::size_t chunk = 64;
+    std::array<mmsghdr, chunk> msgs;
+    std::array<iovec, chunk> iov;
+    std::array<internals::udp_cmsg, chunk> ctl;
+
+    std::size_t sent = 0;
+    while (sent < out.size())
+    {
+        const std::size_t n = std::min(chunk, out.size() - sent);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const auto &o = out[sent + i];
+            iov[i] = {.iov_base = const_cast<char *>(o.data.data()), .iov_len = o.data.size()};
+
+            auto &h = msgs[i].msg_hdr;
+            h = {};
+            h.msg_iov = &iov[i];
+            h.msg_iovlen = 1;
+            if (o.to)
+            {
+                h.msg_name = const_cast<sockaddr *>(o.to->data());
+                h.msg_namelen = o.to->size();
+            }
+            if (o.gso_size)
+            {
+                h.msg_control = ctl[i].buf;
+                h.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+                cmsghdr *c = CMSG_FIRSTHDR(&h);
+                c->cmsg_level = SOL_UDP;
+                c->cmsg_type = UDP_SEGMENT;
+                c->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+                std::memcpy(CMSG_DATA(c), &o.gso_size, sizeof(std::uint16_t));
+            }
+            msgs[i].msg_len = 0;
+        }
+
+        const int r = ::sendmmsg(s.fd, msgs.data(), static_cast<unsigned>(n), flags | MSG_NOSIGNAL);
+        if (r == -1)
+        {
+            if (sent)
+                return sent;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return std::unexpected(Err::app(std::errc::operation_would_block, "Would block/Send buffer full"));
+            return std::unexpected(Err{errno, "sendmmsg failed"});
+        }
+
+        sent += static_cast<std::size_t>(r);
+        if (static_cast<std::size_t>(r) < n)
+            break;
+    }
+    return sent;
+}
+
+}  // namespace rio
@@ -0,0 +1,267 @@
+module;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+
+export module rio:socket.unix_socket;
+import :socket.address;
+import :socket.tcp_socket;
+import :handle;
+import :utils;
+
+import std;
+
+namespace rio {
+
+export enum class unix_type : int
+{
+    stream    = SOCK_STREAM,
+    dgram     = SOCK_DGRAM,
+    seqpacket = SOCK_SEQPACKET,
+};
+
+// AF_UNIX socket, same surface as Tcp_socket. Of the s_opt flags only nonblock and cloexec apply.
+export struct Unix_socket
+{
+    rio::handle fd{};
+
+    Unix_socket() = default;
+    explicit Unix_socket(rio::handle &&h) : fd(std::move(h)) {}
+
+    static auto open(unix_type type = unix_type::stream, s_opt options = s_opt::cloexec) -> result<Unix_socket>;
+    static auto open(const rio::address &address, unix_type type = unix_type::stream, s_opt options = s_opt::cloexec) -> result<Unix_socket>;
+    static auto open_and_listen(const rio::address &address, s_opt options = s_opt::cloexec, int backlog = 128) -> result<Unix_socket>;
+
+    static auto connect(const rio::address &address, unix_type type = unix_type::stream, s_opt options = s_opt::cloexec) -> result<Unix_socket>;
+    static auto pair(unix_type type = unix_type::stream, s_opt options = s_opt::cloexec) -> result<std::pair<Unix_socket, Unix_socket>>;
+
+    static auto attach(int raw_fd) -> Unix_socket;
+    explicit operator bool() const;
+};
+
+auto unix_sock_flags(s_opt options) -> int
+{
+    return (has(options, s_opt::cloexec) ? SOCK_CLOEXEC : 0) | (has(options, s_opt::nonblock) ? SOCK_NONBLOCK : 0);
+}
+
+auto Unix_socket::open(unix_type type, s_opt options) -> result<Unix_socket>
+{
+    const int s = ::socket(AF_UNIX, static_cast<int>(type) | unix_sock_flags(options), 0);
+    if (s == -1)
+        return std::unexpected(Err{errno, "Failed to create unix socket"});
+    return Unix_socket::attach(s);
+}
+
+auto Unix_socket::attach(int raw_fd) -> Unix_socket { return Unix_socket{rio::handle(raw_fd)}; }
+
+Unix_socket::operator bool() const { return static_cast<bool>(fd); }
+
+export auto bind(Unix_socket &s, const address &addr) -> result<void>
+{
+    if (::bind(s.fd, &addr.storage.general, addr.len) == -1) [[unlikely]]
+        return std::unexpected(Err{errno, std::format("Failed to bind unix socket to '{}'", addr)});
+    return {};
+}
+
+export auto listen(Unix_socket &s, int backlog = 128) -> result<void>
+{
+    if (::listen(s.fd, backlog) == -1) [[unlikely]]
+        return std::unexpected(Err{errno, "Failed to listen on unix socket"});
+    return {};
+}
+
+export auto accept(Unix_socket &s, s_opt options = s_opt::none) -> result<std::tuple<Unix_socket, address>>
+{
+    rio::address peer_addr;
+    socklen_t len = sizeof(peer_addr.storage);
+    const int fd = ::accept4(s.fd, &peer_addr.storage.general, &len, SOCK_CLOEXEC | (has(options, s_opt::nonblock) ? SOCK_NONBLOCK : 0));
+
+    if (fd == -1) [[unlikely]]
+        return std::unexpected(Err{errno, "Failed to accept unix connection"});
+
+    peer_addr.len = len;
+    return std::make_tuple(Unix_socket::attach(fd), peer_addr);
+}
+
+export auto try_accept(Unix_socket &s, address &peer_addr) -> result<Unix_socket>
+{
+    socklen_t len = sizeof(peer_addr.storage);
+    const int fd = ::accept4(s.fd, &peer_addr.storage.general, &len, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+    if (fd == -1) [[unlikely]]
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return std::unexpected(Err::app(std::errc::operation_would_block, "Would block/No pending connections"));
+        return std::unexpected(Err{errno, "Failed to accept unix connection"});
+    }
+
+    peer_addr.len = len;
+    return Unix_socket::attach(fd);
+}
+
+auto Unix_socket::open(const rio::address &address, unix_type type, s_opt options) -> result<Unix_socket>
+{
+    if (!address.is_unix())
+        return std::unexpected(Err{EINVAL, "Unix socket needs an AF_UNIX address"});
+
+    auto o_res = open(type, options);
+    if (!o_res) [[unlikely]]
+        return std::unexpected(o_res.error());
+
+    if (auto res = bind(*o_res, address); !res) [[unlikely]]
+        return std::unexpected(res.error());
+
+    return o_res;
+}
+
+auto Unix_socket::open_and_listen(const rio::address &address, s_opt options, int backlog) -> result<Unix_socket>
+{
+    auto o_res = open(address, unix_type::stream, options);
+    if (!o_res) [[unlikely]]
+        return std::unexpected(o_res.error());
+
+    if (auto l_res = rio::listen(*o_res, backlog); !l_res) [[unlikely]]
+        return std::unexpected(l_res.error());
+
+    return o_res;
+}
+
+auto Unix_socket::connect(const rio::address &address, unix_type type, s_opt options) -> result<Unix_socket>
+{
+    // Connected before nonblock is applied, local connects don't wait on a network anyway.
+    auto o_res = open(type, options & s_opt::cloexec);
+    if (!o_res) [[unlikely]]
+        return std::unexpected(o_res.error());
+
+    if (::connect(o_res->fd, &address.storage.general, address.len) == -1) [[unlikely]]
+        return std::unexpected(Err{errno, std::format("Failed to connect to '{}'", address)});
+
+    if (has(options, s_opt::nonblock))
+    {
+        int flags = ::fcntl(o_res->fd, F_GETFL);
+        if (flags == -1 || ::fcntl(o_res->fd, F_SETFL, flags | O_NONBLOCK) == -1)
+            return std::unexpected(Err::sys("Failed to make unix socket non-blocking"));
+    }
+
+    return o_res;
+}
+
+auto Unix_socket::pair(unix_type type, s_opt options) -> result<std::pair<Unix_socket, Unix_socket>>
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, static_cast<int>(type) | unix_sock_flags(options), 0, fds) == -1)
+        return std::unexpected(Err{errno, "Failed to create unix socket pair"});
+    return std::pair{Unix_socket::attach(fds[0]), Unix_socket::attach(fds[1])};
+}
+
+// --- SCM_RIGHTS ---
+
+// Most fds one message carries here, the kernel's own limit is SCM_MAX_FD (253).
+export constexpr std::size_t max_passed_fds = 64;
+
+export struct fd_message
+{
+    std::size_t bytes = 0;
+    std::vector<rio::handle> fds;
+};
+
+namespace internals {
+
+// Control buffer sized for max_passed_fds, aligned for cmsghdr.
+struct fd_cmsg
+{
+    alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(int) * max_passed_fds)];
+};
+
+// Fills msg for sending data + fds, `ctl` must outlive the send.
+inline auto prep_fd_send(msghdr &msg, iovec &iov, fd_cmsg &ctl, std::span<const char> data, std::span<const int> fds) -> result<void>
+{
+    if (fds.size() > max_passed_fds)
+        return std::unexpected(Err::app(std::errc::argument_list_too_long, std::format("At most {} fds per message", max_passed_fds)));
+
+    iov = {.iov_base = const_cast<char *>(data.data()), .iov_len = data.size()};
+    msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (!fds.empty())
+    {
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(c), fds.data(), sizeof(int) * fds.size());
+    }
+    return {};
+}
+
+inline void prep_fd_recv(msghdr &msg, iovec &iov, fd_cmsg &ctl, std::span<char> data)
+{
+    iov = {.iov_base = data.data(), .iov_len = data.size()};
+    msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+}
+
+// Takes ownership of every fd that arrived, even when the message turns out to be truncated.
+inline auto collect_fds(const msghdr &msg, std::size_t bytes) -> result<fd_message>
+{
+    fd_message out{.bytes = bytes, .fds = {}};
+    for (cmsghdr *c = CMSG_FIRSTHDR(const_cast<msghdr *>(&msg)); c; c = CMSG_NXTHDR(const_cast<msghdr *>(&msg), c))
+    {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+            continue;
+        std::size_t n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+            out.fds.emplace_back(fd);
+        }
+    }
+
+    // Some fds were dropped by the kernel, what did arrive is closed with `out`.
+    if (msg.msg_flags & MSG_CTRUNC)
+        return std::unexpected(Err::app(std::errc::message_size, "Received more fds than the control buffer holds"));
+    return out;
+}
+
+}  // namespace internals
+
+// Sends data with fds attached (the peer gets its own copies). At least one data byte is needed on stream sockets.
+export auto send_fds(Unix_socket &s, std::span<const char> data, std::span<const int> fds) -> result<std::size_t>
+{
+    msghdr msg;
+    iovec iov;
+    internals::fd_cmsg ctl;
+    if (auto res = internals::prep_fd_send(msg, iov, ctl, data, fds); !res)
+        return std::unexpected(res.error());
+
+    ssize_t n = ::sendmsg(s.fd.native_handle(), &msg, MSG_NOSIGNAL);
+    if (n == -1)
+        return std::unexpected(Err{errno, "sendmsg with SCM_RIGHTS failed"});
+    return static_cast<std::size_t>(n);
+}
+
+// Receives data and any fds sent with it, close-on-exec. bytes == 0 with no fds means the peer closed.
+export auto recv_fds(Unix_socket &s, std::span<char> data) -> result<fd_message>
+{
+    msghdr msg;
+    iovec iov;
+    internals::fd_cmsg ctl;
+    internals::prep_fd_recv(msg, iov, ctl, data);
+
+    ssize_t n = ::recvmsg(s.fd.native_handle(), &msg, MSG_CMSG_CLOEXEC);
+    if (n == -1)
+        return std::unexpected(Err{errno, "recvmsg failed"});
+    return internals::collect_fds(msg, static_cast<std::size_t>(n));
+}
+
+}  // namespace rio
@@ -0,0 +1,419 @@
+module;
+
+#include <liburing.h>
+#include <cerrno>
+
+export module rio:storage.block_cache;
+
+import std;
+import :context;
+import :file;
+import :utils;
+import :futures;
+import :promise;
+import :fut.io;
+
+namespace rio {
+
+export struct block_cache_options
+{
+    std::size_t block_size = 4096;          // Multiple of 512 if the files are opened with O_DIRECT.
+    std::size_t budget = 64ull << 20;       // Bytes of block data across all shards.
+    std::size_t shards = 16;
+};
+
+// User-space page cache for positional file reads.
+// Blocks are keyed by (fd, block index), split across mutex-guarded shards, and evicted with CLOCK.
+// A miss is filled with a ring read on the caller's context; concurrent misses for the same block from the
+// same context wait on that one read instead of issuing their own.
+//
+// NOTE: The key is the fd, call forget() before closing/reusing a file descriptor.
+export struct block_cache
+{
+    struct stats_t
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t coalesced = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    explicit block_cache(block_cache_options opts = {});
+    ~block_cache();
+
+    block_cache(const block_cache &) = delete;
+    block_cache &operator=(const block_cache &) = delete;
+
+    // Resolves with bytes copied into `out`, short only at EOF. Copies out, so `out` only has to outlive the future.
+    auto read(rio::context &ctx, const rio::file &f, std::uint64_t offset, std::span<char> out);
+
+    // Served only if every block is resident and loaded, never touches the kernel.
+    [[nodiscard]]
+    auto try_read(const rio::file &f, std::uint64_t offset, std::span<char> out) -> std::optional<std::size_t>;
+
+    void forget(const rio::file &f);
+
+    [[nodiscard]] auto stats() const -> stats_t;
+    [[nodiscard]] auto block_size() const -> std::size_t { return opts.block_size; }
+
+private:
+    struct read_op : fut::Async_state<std::size_t>
+    {
+        std::size_t remaining = 0;
+        std::size_t copied = 0;
+        std::error_code err{};
+        rio::context *ctx = nullptr;
+
+        void block_done()
+        {
+            if (--remaining)
+                return;
+            rio::Promise<fut::Async_state<std::size_t>> p{.state = this};
+            if (err)
+                p.reject(err);
+            else
+                p.resolve(copied);
+            io_done = true;
+            if (future_dropped)
+                delete this;
+        }
+    };
+
+    struct waiter
+    {
+        read_op *op;
+        char *dst;
+        std::size_t from;  // Offset within the block
+        std::size_t len;
+    };
+
+    struct key
+    {
+        int fd;
+        std::uint64_t block;
+        bool operator==(const key &) const = default;
+    };
+
+    struct key_hash
+    {
+        auto operator()(const key &k) const noexcept -> std::size_t
+        {
+            return std::hash<std::uint64_t>{}((static_cast<std::uint64_t>(k.fd) << 48) ^ k.block);
+        }
+    };
+
+    enum class slot_state : std::uint8_t { empty, loading, ready };
+
+    struct slot
+    {
+        key k{};
+        char *data = nullptr;
+        std::size_t len = 0;
+        slot_state state = slot_state::empty;
+        bool referenced = false;
+        rio::context *loader = nullptr;
+        std::vector<waiter> waiters;
+    };
+
+    struct shard
+    {
+        mutable std::mutex mtx;
+        std::unordered_map<key, std::uint32_t, key_hash> index;
+        std::vector<slot> slots;
+        std::vector<std::uint32_t> free_list;
+        std::size_t hand = 0;
+        stats_t counters{};
+    };
+
+    struct fill_req
+    {
+        internals::uring_request_header header;
+        block_cache *cache;
+        shard *sh;
+        std::uint32_t idx;
+        slot *bypass = nullptr;  // Set for reads that go around the cache.
+        static void on_complete(internals::uring_request_header *ptr, int res);
+    };
+
+    auto shard_of(const key &k) -> shard & { return shards[key_hash{}(k) % shards.size()]; }
+    auto claim_slot(shard &sh) -> std::optional<std::uint32_t>;
+    static void copy_out(const slot &s, const waiter &w);
+
+    block_cache_options opts;
+    std::size_t slots_per_shard;
+    std::vector<shard> shards;
+};
+
+namespace {
+constexpr std::align_val_t block_align{4096};
+}
+
+block_cache::block_cache(block_cache_options o) : opts(o), shards(std::max<std::size_t>(o.shards, 1))
+{
+    assrt::ensure(opts.block_size > 0 && opts.block_size % 512 == 0, "block_cache: block_size must be a multiple of 512");
+    slots_per_shard = std::max<std::size_t>(opts.budget / opts.block_size / shards.size(), 1);
+    for (auto &sh : shards) sh.slots.reserve(slots_per_shard);
+}
+
+block_cache::~block_cache()
+{
+    for (auto &sh : shards)
+        for (auto &s : sh.slots)
+        {
+            assrt::that(s.state != slot_state::loading, "block_cache destroyed with fills in flight");
+            ::operator delete[](s.data, block_align);
+        }
+}
+
+// Caller holds sh.mtx.
+auto block_cache::claim_slot(shard &sh) -> std::optional<std::uint32_t>
+{
+    if (!sh.free_list.empty())
+    {
+        auto idx = sh.free_list.back();
+        sh.free_list.pop_back();
+        return idx;
+    }
+
+    if (sh.slots.size() < slots_per_shard)
+    {
+        sh.slots.push_back({});
+        sh.slots.back().data = static_cast<char *>(::operator new[](opts.block_size, block_align));
+        return static_cast<std::uint32_t>(sh.slots.size() - 1);
+    }
+
+    // CLOCK: two sweeps are enough to find a victim unless everything is loading.
+    for (std::size_t step = 0; step < 2 * sh.slots.size(); ++step)
+    {
+        auto idx = static_cast<std::uint32_t>(sh.hand);
+        sh.hand = (sh.hand + 1) % sh.slots.size();
+
+        auto &s = sh.slots[idx];
+        if (s.state != slot_state::ready)
+            continue;
+        if (s.referenced)
+        {
+            s.referenced = false;
+            continue;
+        }
+
+        sh.index.erase(s.k);
+        s.state = slot_state::empty;
+        sh.counters.evictions++;
+        return idx;
+    }
+    return std::nullopt;
+}
+
+void block_cache::copy_out(const slot &s, const waiter &w)
+{
+    if (w.from >= s.len)
+        return;
+    std::size_t n = std::min(w.len, s.len - w.from);
+    std::memcpy(w.dst, s.data + w.from, n);
+    w.op->copied += n;
+}
+
+auto block_cache::read(rio::context &ctx, const rio::file &f, std::uint64_t offset, std::span<char> out)
+{
+    const std::size_t bs = opts.block_size;
+    auto *op = new read_op();
+    op->ctx = &ctx;
+
+    std::uint64_t first = offset / bs;
+    std::uint64_t last = out.empty() ? first : (offset + out.size() - 1) / bs;
+
+    // +1 keeps the op alive while we are still issuing blocks, dropped at the end.
+    op->remaining = (out.empty() ? 0 : static_cast<std::size_t>(last - first + 1)) + 1;
+
+    bool submit = false;
+    std::size_t written = 0;
+
+    for (std::uint64_t b = first; b <= last && !out.empty(); ++b)
+    {
+        std::size_t from = (b == first) ? static_cast<std::size_t>(offset % bs) : 0;
+        std::size_t len = std::min(bs - from, out.size() - written);
+        waiter w{.op = op, .dst = out.data() + written, .from = from, .len = len};
+        written += len;
+
+        key k{.fd = f.fd.native_handle(), .block = b};
+        auto &sh = shard_of(k);
+        std::unique_lock lock(sh.mtx);
+
+        if (auto it = sh.index.find(k); it != sh.index.end())
+        {
+            auto &s = sh.slots[it->second];
+            if (s.state == slot_state::ready)
+            {
+                s.referenced = true;
+                sh.counters.hits++;
+                copy_out(s, w);
+                lock.unlock();
+                op->block_done();
+                continue;
+            }
+            // Only waiters on the loader's context can ride along, completion runs on that thread.
+            if (s.loader == &ctx)
+            {
+                sh.counters.coalesced++;
+                s.waiters.push_back(w);
+                continue;
+            }
+        }
+
+        sh.counters.misses++;
+        std::optional<std::uint32_t> idx;
+        if (!sh.index.contains(k))
+            idx = claim_slot(sh);
+
+        if (!idx)
+        {
+            // Another context is loading it, or the shard is saturated with fills: read around the cache.
+            lock.unlock();
+            auto *tmp = new slot{.k = k, .data = static_cast<char *>(::operator new[](bs, block_align)), .waiters = {w}};
+            auto *req = new fill_req{.header = {.call = &fill_req::on_complete}, .cache = this, .sh = nullptr, .idx = 0, .bypass = tmp};
+            auto *sqe = ctx.sqe();
+            io_uring_prep_read(sqe, k.fd, tmp->data, static_cast<unsigned>(bs), b * bs);
+            io_uring_sqe_set_data(sqe, &req->header);
+            submit = true;
+            continue;
+        }
+
+        auto &s = sh.slots[*idx];
+        s.k = k;
+        s.len = 0;
+        s.state = slot_state::loading;
+        s.referenced = true;
+        s.loader = &ctx;
+        s.waiters.assign(1, w);
+        sh.index.emplace(k, *idx);
+        lock.unlock();
+
+        auto *sqe = ctx.sqe();
+        auto *req = new fill_req{.header = {.call = &fill_req::on_complete}, .cache = this, .sh = &sh, .idx = *idx};
+        io_uring_prep_read(sqe, k.fd, s.data, static_cast<unsigned>(bs), b * bs);
+        io_uring_sqe_set_data(sqe, &req->header);
+        submit = true;
+    }
+
+    if (submit)
+        ctx.submit();
+
+    op->block_done();
+    return rio::Future(fut::Async_handle<std::size_t>{op}, fut::Async_poller{});
+}
+
+void block_cache::fill_req::on_complete(internals::uring_request_header *ptr, int res)
+{
+    auto *self = reinterpret_cast<fill_req *>(ptr);
+
+    if (self->bypass)
+    {
+        auto *tmp = self->bypass;
+        auto &w = tmp->waiters.front();
+        if (res < 0)
+            w.op->err = std::error_code(-res, std::system_category());
+        else
+        {
+            tmp->len = static_cast<std::size_t>(res);
+            copy_out(*tmp, w);
+        }
+        w.op->block_done();
+        ::operator delete[](tmp->data, block_align);
+        delete tmp;
+        delete self;
+        return;
+    }
+
+    auto &sh = *self->sh;
+    std::vector<waiter> waiters;
+    {
+        std::lock_guard lock(sh.mtx);
+        auto &s = sh.slots[self->idx];
+        waiters.swap(s.waiters);
+        s.loader = nullptr;
+
+        if (res < 0)
+        {
+            for (auto &w : waiters) w.op->err = std::error_code(-res, std::system_category());
+            sh.index.erase(s.k);
+            s.state = slot_state::empty;
+            sh.free_list.push_back(self->idx);
+        }
+        else
+        {
+            s.len = static_cast<std::size_t>(res);
+            s.state = slot_state::ready;
+            for (auto &w : waiters) copy_out(s, w);
+        }
+    }
+
+    for (auto &w : waiters) w.op->block_done();
+    delete self;
+}
+
+auto block_cache::try_read(const rio::file &f, std::uint64_t offset, std::span<char> out) -> std::optional<std::size_t>
+{
+    const std::size_t bs = opts.block_size;
+    std::size_t done = 0;
+
+    while (done < out.size())
+    {
+        std::uint64_t pos = offset + done;
+        key k{.fd = f.fd.native_handle(), .block = pos / bs};
+        auto &sh = shard_of(k);
+        std::lock_guard lock(sh.mtx);
+
+        auto it = sh.index.find(k);
+        if (it == sh.index.end() || sh.slots[it->second].state != slot_state::ready)
+            return std::nullopt;
+
+        auto &s = sh.slots[it->second];
+        s.referenced = true;
+        sh.counters.hits++;
+
+        std::size_t from = static_cast<std::size_t>(pos % bs);
+        if (from >= s.len)
+            break;  // EOF
+        std::size_t n = std::min(out.size() - done, s.len - from);
+        std::memcpy(out.data() + done, s.data + from, n);
+        done += n;
+
+        if (s.len < bs)
+            break;
+    }
+    return done;
+}
+
+void block_cache::forget(const rio::file &f)
+{
+    const int fd = f.fd.native_handle();
+    for (auto &sh : shards)
+    {
+        std::lock_guard lock(sh.mtx);
+        std::erase_if(sh.index, [&](const auto &kv) {
+            auto &s = sh.slots[kv.second];
+            if (kv.first.fd != fd || s.state != slot_state::ready)
+                return false;
+            s.state = slot_state::empty;
+            sh.free_list.push_back(kv.second);
+            return true;
+        });
+    }
+}
+
+auto block_cache::stats() const -> stats_t
+{
+    stats_t total{};
+    for (const auto &sh : shards)
+    {
+        std::lock_guard lock(sh.mtx);
+        total.hits += sh.counters.hits;
+        total.misses += sh.counters.misses;
+        total.coalesced += sh.counters.coalesced;
+        total.evictions += sh.counters.evictions;
+    }
+    return total;
+}
+
+}  // namespace rio
@@ -0,0 +1,364 @@
+module;
+
+#include <liburing.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <climits>
+
+export module rio:storage.wal;
+
+import std;
+import :context;
+import :file;
+import :utils;
+import :futures;
+import :promise;
+import :fut.io;
+
+namespace rio {
+
+export struct wal_options
+{
+    std::string dir = ".";
+    std::uint64_t segment_size = 64ull << 20;
+    std::size_t max_batch = 256;  // Records per group commit, 2 iovecs each, so <= 512.
+    bool preallocate = true;
+};
+
+// Append-only log with group commit.
+// One batch is in flight at a time: a single pwritev linked to a single fdatasync on the ring.
+// Appends made while a batch is in flight queue up and go out together as the next batch.
+//
+// On-disk record: [u32 length][u32 crc32c(payload)][payload]. A zero length marks the end of a segment,
+// which is why segments are preallocated (zero filled) instead of grown.
+//
+// NOTE: payload is NOT copied, it must stay alive until the append future resolves (same as fut::write).
+export struct wal
+{
+    struct record_header
+    {
+        std::uint32_t len;
+        std::uint32_t crc;
+    };
+
+    struct stats_t
+    {
+        std::uint64_t records = 0;
+        std::uint64_t batches = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    wal(const wal &) = delete;
+    wal &operator=(const wal &) = delete;
+    ~wal();
+
+    [[nodiscard]]
+    static auto open(rio::context &ctx, wal_options opts = {}) -> result<std::unique_ptr<wal>>;
+
+    // Calls fn(lsn, payload) for every intact record, in order. Returns the lsn one past the last record.
+    template <typename Fn>
+    requires std::invocable<Fn &, std::uint64_t, std::string_view>
+    static auto replay(const std::string &dir, Fn &&fn) -> result<std::uint64_t>;
+
+    // Resolves with the record's lsn (global byte offset) once it is on stable storage.
+    auto append(std::span<const char> payload);
+
+    [[nodiscard]] auto next_lsn() const -> std::uint64_t { return tail_lsn; }
+    [[nodiscard]] auto durable_lsn() const -> std::uint64_t { return synced_lsn; }
+    [[nodiscard]] auto stats() const -> const stats_t & { return counters; }
+
+private:
+    struct pending
+    {
+        record_header hdr;
+        std::span<const char> payload;
+        fut::Async_state<std::uint64_t> *state;
+    };
+
+    struct batch
+    {
+        internals::uring_request_header header;
+        wal *owner = nullptr;
+        std::vector<pending> records;
+        std::vector<iovec> iov;
+        std::uint64_t bytes = 0;
+    };
+
+    explicit wal(rio::context &c, wal_options o) : ctx(c), opts(std::move(o)) {}
+
+    auto segment_path(std::uint64_t base) const -> std::string { return std::format("{}/{:020}.wal", opts.dir, base); }
+    auto open_segment(std::uint64_t base, std::uint64_t end) -> result<void>;
+    void submit_batch();
+    static void on_synced(internals::uring_request_header *ptr, int res);
+
+    static auto segments(const std::string &dir) -> std::vector<std::uint64_t>;
+    static auto scan(std::string_view seg, std::uint64_t base, auto &&fn) -> std::uint64_t;
+
+    rio::context &ctx;
+    wal_options opts;
+    rio::file seg{};
+    std::uint64_t seg_base = 0;
+    std::uint64_t seg_off = 0;
+    std::uint64_t tail_lsn = 0;
+    std::uint64_t synced_lsn = 0;
+    std::error_code failed{};
+    bool in_flight = false;
+    std::vector<pending> queue;
+    batch inflight{};
+    stats_t counters{};
+};
+
+auto wal::segments(const std::string &dir) -> std::vector<std::uint64_t>
+{
+    std::vector<std::uint64_t> out;
+    std::error_code ec;
+    for (const auto &e : std::filesystem::directory_iterator(dir, ec))
+    {
+        if (e.path().extension() != ".wal")
+            continue;
+        auto stem = e.path().stem().string();
+        std::uint64_t base = 0;
+        if (std::from_chars(stem.data(), stem.data() + stem.size(), base).ec == std::errc{})
+            out.push_back(base);
+    }
+    std::ranges::sort(out);
+    return out;
+}
+
+// Returns the segment offset one past the last intact record.
+auto wal::scan(std::string_view seg, std::uint64_t base, auto &&fn) -> std::uint64_t
+{
+    std::uint64_t off = 0;
+    while (off + sizeof(record_header) <= seg.size())
+    {
+        record_header h;
+        std::memcpy(&h, seg.data() + off, sizeof(h));
+        if (h.len == 0 || off + sizeof(h) + h.len > seg.size())
+            break;
+
+        auto payload = seg.substr(off + sizeof(h), h.len);
+        if (rio::crc32c::value(payload) != h.crc)
+            break;
+
+        fn(base + off, payload);
+        off += sizeof(h) + h.len;
+    }
+    return off;
+}
+
+template <typename Fn>
+requires std::invocable<Fn &, std::uint64_t, std::string_view>
+auto wal::replay(const std::string &dir, Fn &&fn) -> result<std::uint64_t>
+{
+    std::uint64_t end = 0;
+    for (auto base : segments(dir))
+    {
+        std::ifstream in(std::format("{}/{:020}.wal", dir, base), std::ios::binary);
+        if (!in)
+            return std::unexpected(Err::app(std::errc::io_error, std::format("Failed to open WAL segment {}.", base)));
+
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        end = base + scan(data, base, fn);
+    }
+    return end;
+}
+
+auto wal::open(rio::context &ctx, wal_options opts) -> result<std::unique_ptr<wal>>
+{
+    opts.max_batch = std::clamp<std::size_t>(opts.max_batch, 1, IOV_MAX / 2);
+
+    std::error_code ec;
+    std::filesystem::create_directories(opts.dir, ec);
+    if (ec)
+        return std::unexpected(Err{ec, std::format("Failed to create WAL directory '{}'.", opts.dir)});
+
+    std::unique_ptr<wal> w{new wal(ctx, std::move(opts))};
+
+    // Resume after the last intact record of the newest segment.
+    auto segs = segments(w->opts.dir);
+    std::uint64_t base = segs.empty() ? 0 : segs.back();
+    std::uint64_t end = 0;
+
+    if (!segs.empty())
+    {
+        std::ifstream in(w->segment_path(base), std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        end = scan(data, base, [](std::uint64_t, std::string_view) {});
+    }
+
+    if (auto res = w->open_segment(base, end); !res)
+        return std::unexpected(res.error());
+
+    w->tail_lsn = w->synced_lsn = base + end;
+    return w;
+}
+
+auto wal::open_segment(std::uint64_t base, std::uint64_t end) -> result<void>
+{
+    auto f = rio::file::open(segment_path(base).c_str(), f_mode::rw | f_mode::create | f_mode::cloexec);
+    if (!f)
+        return std::unexpected(f.error());
+
+    // Drop whatever a torn batch left past the end, then zero fill up to segment size.
+    if (::ftruncate(f->fd, static_cast<off_t>(end)) == -1)
+        return std::unexpected(Err::sys("Failed to truncate WAL segment"));
+
+    if (opts.preallocate && ::fallocate(f->fd, 0, 0, static_cast<off_t>(opts.segment_size)) == -1 && errno != EOPNOTSUPP)
+        return std::unexpected(Err::sys("Failed to preallocate WAL segment"));
+
+    // New directory entry must be durable before we acknowledge anything written into it.
+    if (int dfd = ::open(opts.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dfd != -1)
+    {
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+
+    seg = std::move(*f);
+    seg_base = base;
+    seg_off = end;
+    return {};
+}
+
+auto wal::append(std::span<const char> payload)
+{
+    auto *s = new fut::Async_state<std::uint64_t>();
+
+    // Zero length is the end-of-segment marker, so empty records can't be represented. The length field is
+    // 32 bits and a record never spans segments, anything bigger would be cut on disk but not in the lsns.
+    std::error_code bad{};
+    if (payload.empty())
+        bad = std::make_error_code(std::errc::invalid_argument);
+    else if (payload.size() > std::numeric_limits<std::uint32_t>::max() || sizeof(record_header) + payload.size() > opts.segment_size)
+        bad = std::make_error_code(std::errc::message_size);
+
+    if (failed || bad) [[unlikely]]
+    {
+        s->reject(failed ? failed : bad);
+        s->io_done = true;
+        return rio::Future(fut::Async_handle{s}, fut::Async_poller{});
+    }
+
+    queue.push_back({
+        .hdr = {.len = static_cast<std::uint32_t>(payload.size()), .crc = rio::crc32c::value(payload)},
+        .payload = payload,
+        .state = s
+    });
+    tail_lsn += sizeof(record_header) + payload.size();
+
+    // Leader: nothing in flight, go now. Otherwise ride along with the next batch.
+    if (!in_flight)
+        submit_batch();
+
+    return rio::Future(fut::Async_handle{s}, fut::Async_poller{});
+}
+
+void wal::submit_batch()
+{
+    auto &b = inflight;
+    b.records.clear();
+    b.iov.clear();
+    b.bytes = 0;
+
+    std::size_t n = std::min(queue.size(), opts.max_batch);
+    std::ranges::move(queue.begin(), queue.begin() + n, std::back_inserter(b.records));
+    queue.erase(queue.begin(), queue.begin() + n);
+
+    for (const auto &r : b.records) b.bytes += sizeof(record_header) + r.payload.size();
+
+    if (seg_off > 0 && seg_off + b.bytes > opts.segment_size)
+    {
+        if (auto res = open_segment(synced_lsn, 0); !res)
+        {
+            failed = res.error().code;
+            b.owner = this;
+            on_synced(&b.header, -failed.value());
+            return;
+        }
+    }
+
+    b.iov.reserve(b.records.size() * 2);
+    for (auto &r : b.records)
+    {
+        b.iov.push_back({.iov_base = &r.hdr, .iov_len = sizeof(record_header)});
+        if (!r.payload.empty())
+            b.iov.push_back({.iov_base = const_cast<char *>(r.payload.data()), .iov_len = r.payload.size()});
+    }
+
+    b.header.call = &wal::on_synced;
+    b.owner = this;
+
+    // Write and sync are linked: a failed or short write cancels the sync, which is the only completion we track.
+    auto *w_sqe = ctx.sqe();
+    io_uring_prep_writev(w_sqe, seg.fd, b.iov.data(), static_cast<unsigned>(b.iov.size()), seg_off);
+    io_uring_sqe_set_flags(w_sqe, IOSQE_IO_LINK);
+    io_uring_sqe_set_data(w_sqe, nullptr);
+
+    auto *s_sqe = ctx.sqe();
+    io_uring_prep_fsync(s_sqe, seg.fd, IORING_FSYNC_DATASYNC);
+    io_uring_sqe_set_data(s_sqe, &b.header);
+
+    in_flight = true;
+    ctx.submit();
+}
+
+void wal::on_synced(internals::uring_request_header *ptr, int res)
+{
+    auto *b = reinterpret_cast<batch *>(ptr);
+    wal *self = b->owner;
+
+    // -ECANCELED here means the linked write failed or was short.
+    std::error_code ec{};
+    if (res < 0)
+        ec = (res == -ECANCELED) ? std::make_error_code(std::errc::io_error) : std::error_code(-res, std::system_category());
+
+    std::uint64_t lsn = self->synced_lsn;
+    for (auto &r : b->records)
+    {
+        rio::Promise<fut::Async_state<std::uint64_t>> p{.state = r.state};
+        if (ec)
+            p.reject(ec);
+        else
+            p.resolve(lsn);
+
+        lsn += sizeof(record_header) + r.hdr.len;
+        r.state->io_done = true;
+        if (r.state->future_dropped)
+            delete r.state;
+    }
+
+    self->in_flight = false;
+
+    if (ec)
+    {
+        // Position on disk is unknown now, refuse everything after this.
+        self->failed = ec;
+        for (auto &r : self->queue)
+        {
+            r.state->reject(ec);
+            r.state->io_done = true;
+            if (r.state->future_dropped)
+                delete r.state;
+        }
+        self->queue.clear();
+        return;
+    }
+
+    self->seg_off += b->bytes;
+    self->synced_lsn = lsn;
+    self->counters.records += b->records.size();
+    self->counters.bytes += b->bytes;
+    self->counters.batches++;
+
+    if (!self->queue.empty())
+        self->submit_batch();
+}
+
+wal::~wal()
+{
+    // The ring still points into `inflight`, let it land first.
+    while (in_flight) ctx.poll();
+}
+
+}  // namespace rio
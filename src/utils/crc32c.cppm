@@ -0,0 +1,104 @@
+module;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+export module rio:utils.crc32c;
+
+import std;
+
+namespace rio::crc32c {
+
+// Castagnoli polynomial, reflected.
+constexpr std::uint32_t poly = 0x82F63B78u;
+
+constexpr auto make_table() -> std::array<std::uint32_t, 256>
+{
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t i = 0; i < 256; ++i)
+    {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ poly : (c >> 1);
+        t[i] = c;
+    }
+    return t;
+}
+
+constexpr auto table = make_table();
+
+auto extend_sw(std::uint32_t crc, const unsigned char *p, std::size_t n) -> std::uint32_t
+{
+    while (n--) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+auto extend_hw(std::uint32_t crc, const unsigned char *p, std::size_t n) -> std::uint32_t
+{
+    std::uint64_t c = crc;
+
+    // Align to 8 so the 64-bit instruction never splits a cache line.
+    while (n && (reinterpret_cast<std::uintptr_t>(p) & 7))
+    {
+        c = _mm_crc32_u8(static_cast<std::uint32_t>(c), *p++);
+        --n;
+    }
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+    }
+    while (n--) c = _mm_crc32_u8(static_cast<std::uint32_t>(c), *p++);
+
+    return static_cast<std::uint32_t>(c);
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+auto extend_hw(std::uint32_t crc, const unsigned char *p, std::size_t n) -> std::uint32_t
+{
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+    }
+    while (n--) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+#endif
+
+auto has_hw() -> bool
+{
+#if defined(__x86_64__)
+    static const bool ok = __builtin_cpu_supports("sse4.2");
+    return ok;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Continue a running checksum. Start with 0, feed chunks in order.
+export auto extend(std::uint32_t crc, std::span<const char> data) -> std::uint32_t
+{
+    auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    crc = ~crc;
+#if defined(__x86_64__) || (defined(__aarch64__) && defined(__ARM_FEATURE_CRC32))
+    if (has_hw()) [[likely]]
+        return ~extend_hw(crc, p, data.size());
+#endif
+    return ~extend_sw(crc, p, data.size());
+}
+
+export auto value(std::span<const char> data) -> std::uint32_t { return extend(0, data); }
+
+export auto hardware_accelerated() -> bool { return has_hw(); }
+
+}  // namespace rio::crc32c
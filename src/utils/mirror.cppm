@@ -0,0 +1,34 @@
+module;
+
+#include <sys/mman.h>
+#include <cerrno>
+
+export module rio:utils.mirror;
+
+import std;
+import :utils.result;
+
+namespace rio {
+
+// Maps bytes [0, prefix + len) of `fd`, then its [prefix, prefix + len) a second time right behind, so a ring
+// of `len` bytes starting at base + prefix is contiguous across the wrap. prefix and len must be page multiples.
+// Unmap with ::munmap(base, prefix + 2 * len). The mappings keep the memory alive, the fd may be closed after.
+export auto map_mirrored(int fd, std::size_t prefix, std::size_t len) -> result<std::byte *>
+{
+    // Reserve the whole range first so the two copies land back to back.
+    void *area = ::mmap(nullptr, prefix + 2 * len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED)
+        return std::unexpected(Err::sys("Failed to reserve mirrored mapping"));
+
+    auto *b = static_cast<std::byte *>(area);
+    if (::mmap(b, prefix + len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        ::mmap(b + prefix + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, static_cast<off_t>(prefix)) == MAP_FAILED)
+    {
+        auto err = Err::sys("Failed to mirror mapped pages");
+        ::munmap(area, prefix + 2 * len);
+        return std::unexpected(err);
+    }
+    return b;
+}
+
+}  // namespace rio
@@ -0,0 +1,206 @@
+module;
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+
+export module rio:utils.numa;
+
+import std;
+import :utils.result;
+
+// NUMA placement without libnuma: topology from sysfs, policies through the raw syscalls.
+// On single-node machines (or kernels without NUMA) everything degrades to no-ops on node 0.
+
+namespace rio::numa {
+
+constexpr std::size_t max_nodes = 1024;
+using node_mask = std::array<unsigned long, max_nodes / (8 * sizeof(unsigned long))>;
+
+// Callers check valid_node() first, the mask only has room for max_nodes bits.
+auto mask_of(int node) -> node_mask
+{
+    node_mask m{};
+    m[static_cast<std::size_t>(node) / (8 * sizeof(unsigned long))] |= 1ul << (static_cast<std::size_t>(node) % (8 * sizeof(unsigned long)));
+    return m;
+}
+
+// The kernel reads maxnode - 1 bits.
+constexpr unsigned long mask_bits = max_nodes + 1;
+
+auto page_size() -> std::size_t
+{
+    static const auto sz = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return sz;
+}
+
+export auto node_count() -> int
+{
+    static const int count = [] {
+        int n = 0;
+        std::error_code ec;
+        for (const auto &e : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+        {
+            auto name = e.path().filename().string();
+            if (name.starts_with("node") && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4])))
+                ++n;
+        }
+        return std::max(n, 1);
+    }();
+    return count;
+}
+
+// Whether `node` names a node of this machine (and fits a node mask).
+export auto valid_node(int node) -> bool
+{
+    return node >= 0 && node < node_count() && static_cast<std::size_t>(node) < max_nodes;
+}
+
+// Node owning `cpu`, 0 when the topology isn't exposed.
+export auto node_of_cpu(int cpu) -> int
+{
+    std::error_code ec;
+    for (const auto &e : std::filesystem::directory_iterator(std::format("/sys/devices/system/cpu/cpu{}", cpu), ec))
+    {
+        auto name = e.path().filename().string();
+        int node = 0;
+        if (name.starts_with("node") && std::from_chars(name.data() + 4, name.data() + name.size(), node).ec == std::errc{})
+            return node;
+    }
+    return 0;
+}
+
+// Node the calling thread runs on right now.
+export auto current_node() -> int
+{
+    unsigned cpu = 0, node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return 0;
+    return static_cast<int>(node);
+}
+
+// Makes `node` the calling thread's memory policy: every page it first-touches from now on (ring, malloc arenas,
+// request objects, sessions) comes from that node. strict = MPOL_BIND (fail instead of spilling to another node).
+export auto prefer_node(int node, bool strict = false) -> result<void>
+{
+    if (!valid_node(node))
+        return std::unexpected(Err::app(std::errc::invalid_argument, std::format("No NUMA node {}.", node)));
+    if (node_count() < 2)
+        return {};
+    auto m = mask_of(node);
+    if (::syscall(SYS_set_mempolicy, strict ? MPOL_BIND : MPOL_PREFERRED, m.data(), mask_bits) != 0)
+        return std::unexpected(Err::sys(std::format("set_mempolicy(node {}) failed", node)));
+    return {};
+}
+
+// Prefers `node` for the calling thread until the end of the scope, then restores the previous policy.
+// For one-off placement, like a ring set up on a thread that isn't pinned yet. No such node (or node < 0): no-op.
+export struct scoped_node
+{
+    explicit scoped_node(int node)
+    {
+        if (!valid_node(node) || node_count() < 2)
+            return;
+        if (::syscall(SYS_get_mempolicy, &mode, saved.data(), mask_bits, nullptr, 0) != 0)
+            return;
+        active = static_cast<bool>(prefer_node(node));
+    }
+
+    ~scoped_node()
+    {
+        if (active)
+            ::syscall(SYS_set_mempolicy, mode, mode == MPOL_DEFAULT ? nullptr : saved.data(), mode == MPOL_DEFAULT ? 0 : mask_bits);
+    }
+
+    scoped_node(const scoped_node &) = delete;
+    scoped_node &operator=(const scoped_node &) = delete;
+
+private:
+    int mode = MPOL_DEFAULT;
+    node_mask saved{};
+    bool active = false;
+};
+
+// Binds an existing mapping to `node`, moving pages that were already touched elsewhere.
+export auto bind(std::span<std::byte> mem, int node) -> result<void>
+{
+    if (!valid_node(node))
+        return std::unexpected(Err::app(std::errc::invalid_argument, std::format("No NUMA node {}.", node)));
+    if (node_count() < 2 || mem.empty())
+        return {};
+
+    // mbind wants a page aligned start.
+    auto addr = reinterpret_cast<std::uintptr_t>(mem.data());
+    auto start = addr & ~(page_size() - 1);
+    auto len = mem.size() + (addr - start);
+
+    auto m = mask_of(node);
+    if (::syscall(SYS_mbind, start, len, MPOL_BIND, m.data(), mask_bits, MPOL_MF_MOVE) != 0)
+        return std::unexpected(Err::sys(std::format("mbind(node {}) failed", node)));
+    return {};
+}
+
+// Where the pages of a region actually live, as seen from `node`. Untouched pages count as unknown.
+export struct placement
+{
+    std::size_t pages = 0;
+    std::size_t local = 0;
+    std::size_t remote = 0;
+    std::size_t unknown = 0;
+
+    auto operator+=(const placement &o) -> placement &
+    {
+        pages += o.pages;
+        local += o.local;
+        remote += o.remote;
+        unknown += o.unknown;
+        return *this;
+    }
+};
+
+export auto locate(std::span<const std::byte> mem, int node) -> placement
+{
+    placement out;
+    if (mem.empty())
+        return out;
+
+    auto first = reinterpret_cast<std::uintptr_t>(mem.data()) & ~(page_size() - 1);
+    auto last = reinterpret_cast<std::uintptr_t>(mem.data() + mem.size() - 1) & ~(page_size() - 1);
+    out.pages = (last - first) / page_size() + 1;
+
+    if (node_count() < 2)
+    {
+        out.local = out.pages;
+        return out;
+    }
+
+    // move_pages with no target nodes only reports the current node of each page.
+    constexpr std::size_t batch = 512;
+    std::array<void *, batch> pages;
+    std::array<int, batch> status;
+    for (std::size_t done = 0; done < out.pages;)
+    {
+        std::size_t n = std::min(batch, out.pages - done);
+        for (std::size_t i = 0; i < n; ++i) pages[i] = reinterpret_cast<void *>(first + (done + i) * page_size());
+
+        if (::syscall(SYS_move_pages, 0, n, pages.data(), nullptr, status.data(), 0) != 0)
+        {
+            out.unknown += out.pages - done;
+            break;
+        }
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (status[i] < 0)
+                ++out.unknown;
+            else if (status[i] == node)
+                ++out.local;
+            else
+                ++out.remote;
+        }
+        done += n;
+    }
+    return out;
+}
+
+}  // namespace rio::numa
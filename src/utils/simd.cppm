@@ -0,0 +1,70 @@
+module;
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+export module rio:utils.simd;
+
+import std;
+
+// Byte scanning helpers used by the buffered readers and parsers.
+// SSE2 is baseline on x86-64, AVX2 is picked at runtime. Everything else falls back to memchr.
+namespace rio::simd {
+
+#if defined(__x86_64__)
+auto find_sse2(const char *p, const char *end, char c) -> const char *
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        if (int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+    for (; p < end; ++p)
+        if (*p == c)
+            return p;
+    return end;
+}
+
+__attribute__((target("avx2")))
+auto find_avx2(const char *p, const char *end, char c) -> const char *
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        if (unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle))))
+            return p + __builtin_ctz(mask);
+    }
+    return find_sse2(p, end, c);
+}
+
+auto has_avx2() -> bool
+{
+    static const bool ok = __builtin_cpu_supports("avx2");
+    return ok;
+}
+#endif
+
+// First occurrence of `c` in [p, end), or `end`.
+export auto find(const char *p, const char *end, char c) -> const char *
+{
+#if defined(__x86_64__)
+    if (has_avx2())
+        return find_avx2(p, end, c);
+    return find_sse2(p, end, c);
+#else
+    auto *hit = static_cast<const char *>(std::memchr(p, c, static_cast<std::size_t>(end - p)));
+    return hit ? hit : end;
+#endif
+}
+
+export auto find(std::string_view s, char c) -> std::size_t
+{
+    auto *hit = find(s.data(), s.data() + s.size(), c);
+    return hit == s.data() + s.size() ? std::string_view::npos : static_cast<std::size_t>(hit - s.data());
+}
+
+}  // namespace rio::simd
@@ -0,0 +1,111 @@
+module;
+
+export module rio:utils.timer_wheel;
+
+import std;
+
+namespace rio {
+
+// Hashed timing wheel for many coarse timers (idle timeouts, keep-alive expiry): schedule and cancel are O(1)
+// amortised, advance() only walks the slots that passed. Deadlines are rounded up to `resolution`.
+// Not thread safe, driven by whoever owns it (typically one context's loop).
+export struct timer_wheel
+{
+    using clock = std::chrono::steady_clock;
+    using callback = std::function<void()>;
+
+    explicit timer_wheel(std::chrono::milliseconds resolution = std::chrono::milliseconds{10}, std::size_t slots = 512,
+                         clock::time_point start = clock::now())
+        : res(std::max(resolution, std::chrono::milliseconds{1})), origin(start), wheel(std::max<std::size_t>(slots, 1)) {}
+
+    // Returns an id for cancel(), never 0.
+    auto schedule(clock::time_point when, callback fn) -> std::uint64_t
+    {
+        const auto due = std::max(tick_of(when), now_tick + 1);
+        const auto id = next_id++;
+        auto &slot = wheel[due % wheel.size()];
+        slot.push_back({.id = id, .due = due, .fn = std::move(fn)});
+        where.emplace(id, due % wheel.size());
+        return id;
+    }
+
+    template <typename Rep, typename Period>
+    auto schedule_after(std::chrono::duration<Rep, Period> d, callback fn) -> std::uint64_t
+    {
+        return schedule(clock::now() + d, std::move(fn));
+    }
+
+    auto cancel(std::uint64_t id) -> bool
+    {
+        auto it = where.find(id);
+        if (it == where.end())
+            return false;
+        auto &slot = wheel[it->second];
+        where.erase(it);
+        for (std::size_t i = 0; i < slot.size(); ++i)
+            if (slot[i].id == id)
+            {
+                slot[i] = std::move(slot.back());
+                slot.pop_back();
+                return true;
+            }
+        return false;
+    }
+
+    // Fires every timer due at `now`, returns how many. Callbacks may schedule and cancel freely.
+    auto advance(clock::time_point now = clock::now()) -> std::size_t
+    {
+        const auto target = tick_of(now);
+        if (target <= now_tick)
+            return 0;
+
+        // A jump longer than one revolution visits each slot once, the due check catches every lap.
+        const auto steps = std::min<std::uint64_t>(target - now_tick, wheel.size());
+        std::vector<entry> due;
+        for (std::uint64_t t = now_tick + 1; t <= now_tick + steps; ++t)
+        {
+            auto &slot = wheel[t % wheel.size()];
+            for (std::size_t i = slot.size(); i-- > 0;)
+            {
+                if (slot[i].due > target)
+                    continue;
+                where.erase(slot[i].id);
+                due.push_back(std::move(slot[i]));
+                slot[i] = std::move(slot.back());
+                slot.pop_back();
+            }
+        }
+        now_tick = target;
+
+        for (auto &e : due) e.fn();
+        return due.size();
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return where.size(); }
+    [[nodiscard]] auto resolution() const -> std::chrono::milliseconds { return res; }
+
+private:
+    struct entry
+    {
+        std::uint64_t id;
+        std::uint64_t due;  // Absolute tick
+        callback fn;
+    };
+
+    [[nodiscard]] auto tick_of(clock::time_point t) const -> std::uint64_t
+    {
+        if (t <= origin)
+            return 0;
+        // Rounded up: a timer never fires early.
+        return static_cast<std::uint64_t>((t - origin + res - clock::duration{1}) / res);
+    }
+
+    std::chrono::milliseconds res;
+    clock::time_point origin;
+    std::vector<std::vector<entry>> wheel;
+    std::unordered_map<std::uint64_t, std::size_t> where;  // id -> slot
+    std::uint64_t now_tick = 0;
+    std::uint64_t next_id = 1;
+};
+
+}  // namespace rio
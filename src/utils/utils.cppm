@@ -3,3 +3,8 @@ export module rio:utils;
 export import :utils.result;
 export import :utils.assert;
 export import :utils.defer;
+export import :utils.crc32c;
+export import :utils.simd;
+export import :utils.numa;
+export import :utils.timer_wheel;
+export import :utils.mirror;